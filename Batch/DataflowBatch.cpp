@@ -0,0 +1,237 @@
+// ===- DataflowBatch.cpp Runs the dataflow analyses over many bitcode files ---===//
+//
+// Links the Liveness, Reaching and Maypoint passes in and runs their printers
+// over any number of bitcode files in one process:
+//
+//   ./dataflow-batch -analysis=liveness,reaching -function-filter='^main$' a.bc b.bc
+//   ./dataflow-batch -file-list=files.txt -min-instructions=100 -liveness-output=json
+//
+// Each file is memory-mapped and loaded lazily: only the bodies of functions
+// whose name passes -function-filter are materialized. The instruction count
+// is known only once a body is loaded, so -min-instructions and
+// -max-instructions drop functions after materialization. A body is deleted
+// again once its results are printed. The options of the passes (-<pass>-output,
+// -<pass>-solver, -liveness-engine, -<pass>-cache-dir, ...) apply as they do
+// under opt; the hits and misses of each result cache are reported at the end.
+//
+// With -jobs=N files are analysed concurrently, each with its own context;
+// their output is buffered and written in the order of the inputs.
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/PassManager.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Regex.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/WithColor.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Analysis/Dataflow.h"
+#include "../Liveness/LivenessAnalysis.h"
+#include "../Reaching/ReachingAnalysis.h"
+#include "../Maypoint/MaypointAnalysis.h"
+#include <atomic>
+#include <deque>
+#include <string>
+#include <vector>
+
+using namespace llvm;
+
+enum analysisKind { LIVENESS, REACHING, MAYPOINT };
+
+static cl::list<std::string> InputFiles(cl::Positional, cl::ZeroOrMore,
+    cl::desc("<bitcode files>"));
+static cl::opt<std::string> FileList("file-list",
+    cl::desc("File naming one input per line, in addition to the positional ones ('-' for stdin)"),
+    cl::value_desc("filename"));
+static cl::list<analysisKind> Analyses("analysis", cl::CommaSeparated,
+    cl::desc("Analyses to run on each function, in this order (default: all)"),
+    cl::values(clEnumValN(LIVENESS, "liveness", "Live variables"),
+               clEnumValN(REACHING, "reaching", "Reaching definitions"),
+               clEnumValN(MAYPOINT, "maypoint", "May point-to")));
+static cl::opt<std::string> FunctionFilter("function-filter",
+    cl::desc("Analyse only functions whose name matches this regular expression"),
+    cl::value_desc("regex"));
+static cl::opt<unsigned> MinInstructions("min-instructions",
+    cl::desc("Skip functions with fewer instructions"),
+    cl::init(0));
+static cl::opt<unsigned> MaxInstructions("max-instructions",
+    cl::desc("Skip functions with more instructions (0 = no limit)"),
+    cl::init(0));
+static cl::opt<unsigned> Jobs("jobs",
+    cl::desc("Files analysed concurrently (0 = all hardware threads)"),
+    cl::init(1));
+static cl::opt<bool> FileHeaders("file-headers",
+    cl::desc("Print '; file <path>' before the results of each file"),
+    cl::init(true));
+
+namespace {
+  // Functions seen and analysed across all files
+  struct batchCounters{
+    std::atomic<unsigned long> functions{0};
+    std::atomic<unsigned long> analysed{0};
+    std::atomic<unsigned long> failed_files{0};
+  };
+
+  // Analyses one file and writes its results to OS. Errors go to stderr.
+  class fileAnalyzer{
+    public:
+      fileAnalyzer(ArrayRef<analysisKind> analyses, const Regex* filter, batchCounters& counters) : analyses(analyses), filter(filter), counters(counters) {}
+
+      void run(const std::string& path, raw_ostream& OS){
+        ErrorOr<std::unique_ptr<MemoryBuffer>> buffer = MemoryBuffer::getFileOrSTDIN(path, /*IsText=*/false, /*RequiresNullTerminator=*/false);
+        if(!buffer){
+          WithColor::error(errs(), "dataflow-batch") << path << ": " << buffer.getError().message() << "\n";
+          counters.failed_files++;
+          return;
+        }
+        LLVMContext context;
+        SMDiagnostic err;
+        std::unique_ptr<Module> M = getLazyIRModule(std::move(*buffer), err, context, /*ShouldLazyLoadMetadata=*/true);
+        if(!M){
+          err.print("dataflow-batch", errs());
+          counters.failed_files++;
+          return;
+        }
+
+        PassBuilder PB;
+        getLivenessPluginInfo().RegisterPassBuilderCallbacks(PB);
+        getReachingPluginInfo().RegisterPassBuilderCallbacks(PB);
+        getMaypointPluginInfo().RegisterPassBuilderCallbacks(PB);
+        FunctionAnalysisManager FAM;
+        PB.registerFunctionAnalyses(FAM);
+        FunctionPassManager FPM;
+        for(analysisKind analysis : analyses){
+          switch(analysis){
+            case LIVENESS: FPM.addPass(liveness::LivenessPrinterPass(OS)); break;
+            case REACHING: FPM.addPass(reaching::ReachingPrinterPass(OS)); break;
+            case MAYPOINT: FPM.addPass(maypoint::MayPointPrinterPass(OS)); break;
+          }
+        }
+
+        if(FileHeaders){
+          OS << "; file " << path << "\n";
+        }
+        for(Function& F : *M){
+          if(F.isDeclaration()){
+            continue;
+          }
+          counters.functions++;
+          if(filter && !filter->match(F.getName())){
+            continue;
+          }
+          if(Error error = F.materialize()){
+            WithColor::error(errs(), "dataflow-batch") << path << ": " << toString(std::move(error)) << "\n";
+            counters.failed_files++;
+            return;
+          }
+          unsigned size = F.getInstructionCount();
+          if(size >= MinInstructions && (MaxInstructions == 0 || size <= MaxInstructions)){
+            FPM.run(F, FAM);
+            counters.analysed++;
+          }
+          FAM.clear(F, F.getName());
+          F.deleteBody();
+        }
+      }
+
+    private:
+      ArrayRef<analysisKind> analyses;
+      const Regex* filter;
+      batchCounters& counters;
+  };
+
+  bool readFileList(StringRef list, std::vector<std::string>& files){
+    ErrorOr<std::unique_ptr<MemoryBuffer>> buffer = MemoryBuffer::getFileOrSTDIN(list);
+    if(!buffer){
+      WithColor::error(errs(), "dataflow-batch") << list << ": " << buffer.getError().message() << "\n";
+      return false;
+    }
+    SmallVector<StringRef, 64> lines;
+    (*buffer)->getBuffer().split(lines, '\n', -1, false);
+    for(StringRef line : lines){
+      line = line.trim();
+      if(!line.empty()){
+        files.push_back(line.str());
+      }
+    }
+    return true;
+  }
+}
+
+int main(int argc, char** argv){
+  InitLLVM X(argc, argv);
+  cl::ParseCommandLineOptions(argc, argv, "Batch dataflow analysis driver\n");
+  std::vector<std::string> files(InputFiles.begin(), InputFiles.end());
+  if(!FileList.empty() && !readFileList(FileList, files)){
+    return 1;
+  }
+  if(files.empty()){
+    WithColor::error(errs(), "dataflow-batch") << "no input files\n";
+    return 1;
+  }
+  std::vector<analysisKind> analyses(Analyses.begin(), Analyses.end());
+  if(analyses.empty()){
+    analyses = {LIVENESS, REACHING, MAYPOINT};
+  }
+  Optional<Regex> filter;
+  if(!FunctionFilter.empty()){
+    filter.emplace(FunctionFilter);
+    std::string message;
+    if(!filter->isValid(message)){
+      WithColor::error(errs(), "dataflow-batch") << "-function-filter: " << message << "\n";
+      return 1;
+    }
+  }
+
+  batchCounters counters;
+  fileAnalyzer analyzer(analyses, filter ? filter.getPointer() : nullptr, counters);
+  unsigned threads = hardware_concurrency(Jobs).compute_thread_count();
+  if(threads <= 1 || files.size() <= 1){
+    for(const std::string& path : files){
+      analyzer.run(path, outs());
+    }
+  }
+  else{
+    // A bounded window of files is in flight; each one's output is written
+    // as soon as the files before it are done
+    ThreadPool pool(hardware_concurrency(threads));
+    std::deque<std::pair<std::shared_future<void>, std::unique_ptr<std::string>>> pending;
+    unsigned next = 0;
+    while(next < files.size() || !pending.empty()){
+      while(next < files.size() && pending.size() < 2 * threads){
+        std::unique_ptr<std::string> output(new std::string());
+        std::string* destination = output.get();
+        const std::string& path = files[next++];
+        std::shared_future<void> done = pool.async([&analyzer, &path, destination](){
+          in_parallel_worker() = true;
+          raw_string_ostream buffer(*destination);
+          analyzer.run(path, buffer);
+          buffer.flush();
+        });
+        pending.emplace_back(done, std::move(output));
+      }
+      pending.front().first.wait();
+      outs() << *pending.front().second;
+      pending.pop_front();
+    }
+  }
+  outs().flush();
+  errs() << "dataflow-batch: " << files.size() << " files, " << counters.analysed << " of "
+         << counters.functions << " functions analysed\n";
+  std::pair<const char*, resultCache*> caches[] = {
+    {"liveness", getLivenessResultCache()},
+    {"reaching", getReachingResultCache()},
+    {"maypoint", getMaypointResultCache()}};
+  for(auto& named : caches){
+    if(resultCache* cache = named.second){
+      errs() << "dataflow-batch: " << named.first << " cache: " << cache->hits << " hits, " << cache->misses
+             << " misses, " << cache->stores << " stores, " << cache->evictions << " evictions\n";
+    }
+  }
+  return counters.failed_files ? 1 : 0;
+}
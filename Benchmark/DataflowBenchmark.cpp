@@ -0,0 +1,1029 @@
+// ===- DataflowBenchmark.cpp Benchmarks the dataflow solvers on synthetic CFGs ---===//
+//
+// Generates LLVM functions of a chosen shape and size, runs the Liveness,
+// Reaching and Maypoint solvers over them and writes one JSON object per line
+// and per (function, analysis) pair:
+//
+//   {"shape":"loops","size":8,"blocks":..,"instructions":..,"analysis":"liveness",
+//    "solver":"worklist","construct_ms":..,"solve_ms":..,"wall_ms":..,
+//    "iterations":..,"block_evaluations":..,"meets":..,"arena_kb":..,"peak_rss_kb":..}
+//
+// arena_kb is the lattice arena reserved by the solve; peak_rss_kb is the peak
+// resident set size of the whole process so far. The flow-insensitive andersen
+// analysis has no blocks to iterate over; its records report propagations,
+// copy_edges and collapsed nodes instead of the solver counters. The
+// interference analyses time liveness as construct_ms and building the
+// interference graph from it as solve_ms, and add the edges and the maximum
+// register pressure found: "interference" sweeps each block once,
+// "interference-naive" joins every pair of values in the live set of every
+// instruction, as a consumer of the printed sets would.
+//
+// -verify runs consistency checks on the generated functions instead of
+// timing them, printing {"shape":..,"size":..,"check":..,"analysis":..,"ok":..}
+// per check, and exits with 1 if one fails.
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Analysis/Dataflow.h"
+#include "../Liveness/Liveness.h"
+#include "../Liveness/Interference.h"
+#include "../Reaching/Reaching.h"
+#include "../Maypoint/Maypoint.h"
+#include "../Maypoint/Andersen.h"
+#include <chrono>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+
+using namespace llvm;
+
+enum shapeKind { LOOPS, DIAMONDS, SWITCH, STRAIGHT, PHIS, POINTERS, WIDE, LOOP_SWITCH, WINDOW };
+enum analysisKind { LIVENESS, LIVENESS_SPARSE, REACHING, REACHING_CONDENSED, MAYPOINT, ANDERSEN, INTERFERENCE, INTERFERENCE_NAIVE };
+
+static cl::list<shapeKind> Shapes("shape", cl::CommaSeparated,
+    cl::desc("Shapes of the generated functions (default: all)"),
+    cl::values(clEnumValN(LOOPS, "loops", "Loop nest of depth <size>"),
+               clEnumValN(DIAMONDS, "diamonds", "<size> if/else diamonds in sequence"),
+               clEnumValN(SWITCH, "switch", "A switch with <size> cases"),
+               clEnumValN(STRAIGHT, "straight", "One block of <size> instructions"),
+               clEnumValN(PHIS, "phis", "A loop header with <size> phi nodes"),
+               clEnumValN(POINTERS, "pointers", "<size> alloca/store/load pointer chains in a loop"),
+               clEnumValN(WIDE, "wide", "<size> values defined up front, each used by one case of a switch"),
+               clEnumValN(LOOP_SWITCH, "loop-switch", "A switch with <size> cases, each a loop nest of depth 2"),
+               clEnumValN(WINDOW, "window", "A loop body of <size> values, each using the ones defined 1 and 16 before it")));
+static cl::list<analysisKind> Analyses("analysis", cl::CommaSeparated,
+    cl::desc("Analyses to run (default: all)"),
+    cl::values(clEnumValN(LIVENESS, "liveness", "Live variables"),
+               clEnumValN(LIVENESS_SPARSE, "liveness-sparse", "Live variables walked backward from the uses of each value"),
+               clEnumValN(REACHING, "reaching", "Reaching definitions"),
+               clEnumValN(REACHING_CONDENSED, "reaching-condensed", "Reaching definitions in one pass over the CFG's strongly connected components"),
+               clEnumValN(MAYPOINT, "maypoint", "May point-to"),
+               clEnumValN(ANDERSEN, "andersen", "Flow-insensitive may point-to"),
+               clEnumValN(INTERFERENCE, "interference", "Interference graph and register pressure from liveness, one sweep per block"),
+               clEnumValN(INTERFERENCE_NAIVE, "interference-naive", "Interference graph from every pair of values live at each instruction")));
+static cl::list<unsigned> Sizes("size", cl::CommaSeparated,
+    cl::desc("Sizes of the generated functions (default: 16,256)"));
+static cl::opt<solverStrategy> Solver("solver",
+    cl::desc("Fixed-point strategy"),
+    cl::init(WORKLIST), solverStrategyValues());
+static cl::opt<unsigned> Threads("solver-threads",
+    cl::desc("Threads used by -solver=components (0 = all hardware threads)"),
+    cl::init(0));
+static cl::opt<unsigned> Repeat("repeat",
+    cl::desc("Runs per (function, analysis); the fastest is reported"),
+    cl::init(3));
+static cl::opt<unsigned> MaxSetSize("max-set-size",
+    cl::desc("Collapse Maypoint points-to sets with more elements to unknown (0 = no limit)"),
+    cl::init(0));
+static cl::opt<unsigned> MatrixSize("matrix-size",
+    cl::desc("MiB up to which the interference graph keeps a bit matrix"),
+    cl::init(64));
+static cl::opt<bool> Reanalyze("reanalyze",
+    cl::desc("Also time re-solving liveness, reaching and maypoint after splitting one edge in the middle of a fresh copy of each function"),
+    cl::init(false));
+static cl::opt<bool> Verify("verify",
+    cl::desc("Run consistency checks on the generated functions instead of timing them"),
+    cl::init(false));
+static cl::opt<bool> DumpIR("dump-ir",
+    cl::desc("Print the generated functions to stderr"),
+    cl::init(false));
+
+namespace {
+  const char* shapeName(shapeKind shape){
+    switch(shape){
+      case LOOPS: return "loops";
+      case DIAMONDS: return "diamonds";
+      case SWITCH: return "switch";
+      case STRAIGHT: return "straight";
+      case PHIS: return "phis";
+      case POINTERS: return "pointers";
+      case WIDE: return "wide";
+      case LOOP_SWITCH: return "loop-switch";
+      case WINDOW: return "window";
+    }
+    return "unknown";
+  }
+
+  const char* analysisName(analysisKind analysis){
+    switch(analysis){
+      case LIVENESS: return "liveness";
+      case LIVENESS_SPARSE: return "liveness-sparse";
+      case REACHING: return "reaching";
+      case REACHING_CONDENSED: return "reaching-condensed";
+      case MAYPOINT: return "maypoint";
+      case ANDERSEN: return "andersen";
+      case INTERFERENCE: return "interference";
+      case INTERFERENCE_NAIVE: return "interference-naive";
+    }
+    return "unknown";
+  }
+
+  const char* solverName(solverStrategy strategy){
+    switch(strategy){
+      case ROUND_ROBIN: return "round-robin";
+      case WORKLIST: return "worklist";
+      case COMPONENTS: return "components";
+    }
+    return "unknown";
+  }
+
+  long peakRSSKilobytes(){
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) != 0){
+      return -1;
+    }
+    return usage.ru_maxrss;
+  }
+
+  // Builds synthetic functions of the form i32 f(i32 %n, i32 %seed)
+  class cfgGenerator{
+    public:
+      cfgGenerator(Module& M) : M(M), C(M.getContext()), B(C) {}
+
+      Function* generate(shapeKind shape, unsigned size){
+        std::string name = std::string(shapeName(shape)) + "_" + std::to_string(size);
+        Type* i32 = Type::getInt32Ty(C);
+        FunctionType* type = FunctionType::get(i32, {i32, i32}, false);
+        F = Function::Create(type, Function::ExternalLinkage, name, &M);
+        auto arg = F->arg_begin();
+        n = &*arg++;
+        n->setName("n");
+        seed = &*arg;
+        seed->setName("seed");
+        B.SetInsertPoint(BasicBlock::Create(C, "entry", F));
+        Value* result = nullptr;
+        switch(shape){
+          case LOOPS: result = loopNest(size, seed); break;
+          case DIAMONDS: result = diamonds(size); break;
+          case SWITCH: result = bigSwitch(size); break;
+          case STRAIGHT: result = straightLine(size); break;
+          case PHIS: result = manyPhis(size); break;
+          case POINTERS: result = pointerChains(size); break;
+          case WIDE: result = wideSwitch(size); break;
+          case LOOP_SWITCH: result = loopSwitch(size); break;
+          case WINDOW: result = windowLoop(size); break;
+        }
+        B.CreateRet(result);
+        return F;
+      }
+
+    private:
+      Module& M;
+      LLVMContext& C;
+      IRBuilder<> B;
+      Function* F;
+      Value* n;
+      Value* seed;
+
+      BasicBlock* block(const char* name){
+        return BasicBlock::Create(C, name, F);
+      }
+
+      // for(i = 0; i < n; i++) acc = <inner>(acc + i), nested depth times
+      Value* loopNest(unsigned depth, Value* acc){
+        BasicBlock* preheader = B.GetInsertBlock();
+        BasicBlock* header = block("header");
+        BasicBlock* body = block("body");
+        BasicBlock* exit = block("exit");
+        B.CreateBr(header);
+        B.SetInsertPoint(header);
+        PHINode* i = B.CreatePHI(B.getInt32Ty(), 2, "i");
+        PHINode* sum = B.CreatePHI(B.getInt32Ty(), 2, "sum");
+        i->addIncoming(B.getInt32(0), preheader);
+        sum->addIncoming(acc, preheader);
+        B.CreateCondBr(B.CreateICmpSLT(i, n), body, exit);
+        B.SetInsertPoint(body);
+        Value* next = B.CreateAdd(sum, i);
+        if(depth > 1){
+          next = loopNest(depth - 1, next);
+        }
+        Value* inc = B.CreateAdd(i, B.getInt32(1));
+        i->addIncoming(inc, B.GetInsertBlock());
+        sum->addIncoming(next, B.GetInsertBlock());
+        B.CreateBr(header);
+        B.SetInsertPoint(exit);
+        return sum;
+      }
+
+      Value* diamonds(unsigned count){
+        Value* acc = seed;
+        for(unsigned k = 0; k < count; k++){
+          BasicBlock* then_block = block("then");
+          BasicBlock* else_block = block("else");
+          BasicBlock* merge = block("merge");
+          B.CreateCondBr(B.CreateICmpSLT(acc, B.getInt32(k)), then_block, else_block);
+          B.SetInsertPoint(then_block);
+          Value* a = B.CreateAdd(acc, n);
+          B.CreateBr(merge);
+          B.SetInsertPoint(else_block);
+          Value* b = B.CreateMul(acc, B.getInt32(k + 2));
+          B.CreateBr(merge);
+          B.SetInsertPoint(merge);
+          PHINode* phi = B.CreatePHI(B.getInt32Ty(), 2, "d");
+          phi->addIncoming(a, then_block);
+          phi->addIncoming(b, else_block);
+          acc = phi;
+        }
+        return acc;
+      }
+
+      Value* bigSwitch(unsigned cases){
+        BasicBlock* merge = block("merge");
+        BasicBlock* default_block = block("default");
+        SwitchInst* sw = B.CreateSwitch(seed, default_block, cases);
+        std::vector<std::pair<Value*, BasicBlock*>> incoming;
+        for(unsigned k = 0; k < cases; k++){
+          BasicBlock* case_block = block("case");
+          sw->addCase(B.getInt32(k), case_block);
+          B.SetInsertPoint(case_block);
+          Value* v = B.CreateAdd(B.CreateMul(n, B.getInt32(k)), seed);
+          B.CreateBr(merge);
+          incoming.push_back(std::make_pair(v, case_block));
+        }
+        B.SetInsertPoint(default_block);
+        B.CreateBr(merge);
+        incoming.push_back(std::make_pair(n, default_block));
+        B.SetInsertPoint(merge);
+        PHINode* phi = B.CreatePHI(B.getInt32Ty(), incoming.size(), "r");
+        for(auto& in : incoming){
+          phi->addIncoming(in.first, in.second);
+        }
+        return phi;
+      }
+
+      // Wide and shallow: count values all live out of the entry block, each
+      // used in a single case of a switch
+      Value* wideSwitch(unsigned count){
+        std::vector<Value*> values;
+        for(unsigned k = 0; k < count; k++){
+          values.push_back(B.CreateMul(seed, B.getInt32(k + 1)));
+        }
+        BasicBlock* merge = block("merge");
+        BasicBlock* default_block = block("default");
+        SwitchInst* sw = B.CreateSwitch(n, default_block, count);
+        B.SetInsertPoint(merge);
+        PHINode* phi = B.CreatePHI(B.getInt32Ty(), count + 1, "r");
+        for(unsigned k = 0; k < count; k++){
+          BasicBlock* case_block = block("case");
+          sw->addCase(B.getInt32(k), case_block);
+          B.SetInsertPoint(case_block);
+          Value* v = B.CreateAdd(values[k], n);
+          B.CreateBr(merge);
+          phi->addIncoming(v, case_block);
+        }
+        B.SetInsertPoint(default_block);
+        B.CreateBr(merge);
+        phi->addIncoming(seed, default_block);
+        B.SetInsertPoint(merge);
+        return phi;
+      }
+
+      // Independent loop nests, one per case: many strongly connected
+      // components with no path between them
+      Value* loopSwitch(unsigned cases){
+        BasicBlock* merge = block("merge");
+        BasicBlock* default_block = block("default");
+        SwitchInst* sw = B.CreateSwitch(seed, default_block, cases);
+        std::vector<std::pair<Value*, BasicBlock*>> incoming;
+        for(unsigned k = 0; k < cases; k++){
+          BasicBlock* case_block = block("case");
+          sw->addCase(B.getInt32(k), case_block);
+          B.SetInsertPoint(case_block);
+          Value* v = loopNest(2, B.CreateMul(n, B.getInt32(k)));
+          incoming.push_back(std::make_pair(v, B.GetInsertBlock()));
+          B.CreateBr(merge);
+        }
+        B.SetInsertPoint(default_block);
+        B.CreateBr(merge);
+        incoming.push_back(std::make_pair(n, default_block));
+        B.SetInsertPoint(merge);
+        PHINode* phi = B.CreatePHI(B.getInt32Ty(), incoming.size(), "r");
+        for(auto& in : incoming){
+          phi->addIncoming(in.first, in.second);
+        }
+        return phi;
+      }
+
+      // Many values in few blocks, each live for a short stretch, so the
+      // register pressure stays bounded as count grows
+      Value* windowLoop(unsigned count){
+        BasicBlock* preheader = B.GetInsertBlock();
+        BasicBlock* header = block("header");
+        BasicBlock* body = block("body");
+        BasicBlock* exit = block("exit");
+        B.CreateBr(header);
+        B.SetInsertPoint(header);
+        PHINode* i = B.CreatePHI(B.getInt32Ty(), 2, "i");
+        PHINode* acc = B.CreatePHI(B.getInt32Ty(), 2, "acc");
+        i->addIncoming(B.getInt32(0), preheader);
+        acc->addIncoming(seed, preheader);
+        B.CreateCondBr(B.CreateICmpSLT(i, n), body, exit);
+        B.SetInsertPoint(body);
+        std::vector<Value*> values = {acc, i};
+        for(unsigned k = 0; k < count; k++){
+          Value* a = values[values.size() - 1];
+          Value* b = values[values.size() >= 16 ? values.size() - 16 : 0];
+          values.push_back(k % 2 ? B.CreateAdd(a, b) : B.CreateXor(a, b));
+        }
+        Value* inc = B.CreateAdd(i, B.getInt32(1));
+        i->addIncoming(inc, body);
+        acc->addIncoming(values.back(), body);
+        B.CreateBr(header);
+        B.SetInsertPoint(exit);
+        return acc;
+      }
+
+      Value* straightLine(unsigned count){
+        std::vector<Value*> values = {n, seed};
+        for(unsigned k = 0; k < count; k++){
+          Value* a = values[values.size() - 1];
+          Value* b = values[values.size() / 2];
+          values.push_back(k % 2 ? B.CreateAdd(a, b) : B.CreateXor(a, b));
+        }
+        return values.back();
+      }
+
+      // A loop whose header rotates count values through phi nodes
+      Value* manyPhis(unsigned count){
+        std::vector<Value*> initial;
+        for(unsigned k = 0; k < count; k++){
+          initial.push_back(B.CreateAdd(seed, B.getInt32(k)));
+        }
+        BasicBlock* preheader = B.GetInsertBlock();
+        BasicBlock* header = block("header");
+        BasicBlock* body = block("body");
+        BasicBlock* exit = block("exit");
+        B.CreateBr(header);
+        B.SetInsertPoint(header);
+        PHINode* i = B.CreatePHI(B.getInt32Ty(), 2, "i");
+        i->addIncoming(B.getInt32(0), preheader);
+        std::vector<PHINode*> phis;
+        for(unsigned k = 0; k < count; k++){
+          PHINode* phi = B.CreatePHI(B.getInt32Ty(), 2, "p");
+          phi->addIncoming(initial[k], preheader);
+          phis.push_back(phi);
+        }
+        B.CreateCondBr(B.CreateICmpSLT(i, n), body, exit);
+        B.SetInsertPoint(body);
+        Value* inc = B.CreateAdd(i, B.getInt32(1));
+        i->addIncoming(inc, body);
+        for(unsigned k = 0; k < count; k++){
+          Value* rotated = phis[(k + 1) % count];
+          if(k % 4 == 0){
+            rotated = B.CreateAdd(rotated, i);
+          }
+          phis[k]->addIncoming(rotated, body);
+        }
+        B.CreateBr(header);
+        B.SetInsertPoint(exit);
+        Value* sum = i;
+        for(unsigned k = 0; k < count; k += std::max(1u, count / 8)){
+          sum = B.CreateAdd(sum, phis[k]);
+        }
+        return sum;
+      }
+
+      // count chains of i32 slots reached through i32* cells, permuted by
+      // stores inside a loop, with GEPs, bitcasts, selects and a pointer phi
+      Value* pointerChains(unsigned count){
+        Type* i32 = B.getInt32Ty();
+        Type* i32_ptr = i32->getPointerTo();
+        Type* i8_ptr = B.getInt8Ty()->getPointerTo();
+        std::vector<Value*> slots, cells;
+        for(unsigned k = 0; k < count; k++){
+          slots.push_back(B.CreateAlloca(i32, B.getInt32(2), "slot"));
+          cells.push_back(B.CreateAlloca(i32_ptr, nullptr, "cell"));
+          B.CreateStore(slots.back(), cells.back());
+        }
+        BasicBlock* preheader = B.GetInsertBlock();
+        BasicBlock* header = block("header");
+        BasicBlock* body = block("body");
+        BasicBlock* exit = block("exit");
+        B.CreateBr(header);
+        B.SetInsertPoint(header);
+        PHINode* i = B.CreatePHI(i32, 2, "i");
+        PHINode* current = B.CreatePHI(i32_ptr, 2, "current");
+        i->addIncoming(B.getInt32(0), preheader);
+        current->addIncoming(slots[0], preheader);
+        Value* cond = B.CreateICmpSLT(i, n);
+        B.CreateCondBr(cond, body, exit);
+        B.SetInsertPoint(body);
+        Value* chosen = current;
+        for(unsigned k = 0; k < count; k++){
+          Value* loaded = B.CreateLoad(i32_ptr, cells[k], "loaded");
+          Value* element = B.CreateGEP(i32, loaded, B.getInt32(1), "element");
+          Value* raw = B.CreateBitCast(element, i8_ptr, "raw");
+          Value* typed = B.CreateBitCast(raw, i32_ptr, "typed");
+          chosen = B.CreateSelect(cond, typed, chosen, "chosen");
+          B.CreateStore(chosen, cells[(k + 1) % count]);
+          B.CreateStore(i, loaded);
+        }
+        Value* inc = B.CreateAdd(i, B.getInt32(1));
+        i->addIncoming(inc, body);
+        current->addIncoming(chosen, body);
+        B.CreateBr(header);
+        B.SetInsertPoint(exit);
+        return B.CreateLoad(i32, current);
+      }
+  };
+
+  struct runResult{
+    double construct_ms;
+    double solve_ms;
+    solverCounters counters;
+    maypoint::andersenCounters andersen;
+    size_t arena_bytes;
+    uint64_t collapsed_sets = 0;
+    uint64_t interferences = 0;
+    unsigned max_pressure = 0;
+    bool matrix = false;
+  };
+
+  double millisecondsSince(std::chrono::steady_clock::time_point start){
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  // Points-to sets collapsed by -max-set-size; only Maypoint has a budget
+  template<typename DFA>
+  uint64_t collapsedSets(DFA&){
+    return 0;
+  }
+
+  uint64_t collapsedSets(maypoint::mayPoint& dfa){
+    return dfa.context.collapsed_sets;
+  }
+
+  template<typename DFA, typename T>
+  runResult runSolver(Function& F, T (*initial_of)(DFA&)){
+    runResult result;
+    auto start = std::chrono::steady_clock::now();
+    DFA dfa(F);
+    dfa.strategy = Solver;
+    dfa.threads = Threads;
+    blockState<T> state = dfa.initial_state(initial_of(dfa));
+    result.construct_ms = millisecondsSince(start);
+    start = std::chrono::steady_clock::now();
+    dfa.run_dataflow(F, state);
+    result.solve_ms = millisecondsSince(start);
+    result.counters = dfa.counters;
+    result.arena_bytes = dfa.arena.peak_bytes();
+    result.collapsed_sets = collapsedSets(dfa);
+    return result;
+  }
+
+  // Splits an edge into the middle block of F, returning the blocks to
+  // report as dirty
+  std::vector<BasicBlock*> splitMiddleEdge(Function& F){
+    std::vector<BasicBlock*> blocks;
+    for(BasicBlock& bb : F){
+      blocks.push_back(&bb);
+    }
+    for(unsigned pos = blocks.size() / 2; pos < blocks.size(); pos++){
+      BasicBlock* target = blocks[pos];
+      if(pred_empty(target)){
+        continue;
+      }
+      BasicBlock* source = *pred_begin(target);
+      BasicBlock* split = BasicBlock::Create(F.getContext(), "split", &F, target);
+      BranchInst::Create(target, split);
+      Instruction* terminator = source->getTerminator();
+      for(unsigned succ = 0; succ < terminator->getNumSuccessors(); succ++){
+        if(terminator->getSuccessor(succ) == target){
+          terminator->setSuccessor(succ, split);
+          break;
+        }
+      }
+      for(PHINode& phi : target->phis()){
+        phi.setIncomingBlock(phi.getBasicBlockIndex(source), split);
+      }
+      return {source, split, target};
+    }
+    return {};
+  }
+
+  // Solves F, splits an edge and times bringing the result up to date
+  template<typename DFA, typename T>
+  runResult runReanalysis(Function& F, T (*initial_of)(DFA&)){
+    runResult result;
+    DFA dfa(F);
+    dfa.strategy = Solver;
+    blockState<T> state = dfa.initial_state(initial_of(dfa));
+    dfa.run_dataflow(F, state);
+    std::vector<BasicBlock*> dirty = splitMiddleEdge(F);
+    auto start = std::chrono::steady_clock::now();
+    dfa.reanalyze(F, state, dirty);
+    result.construct_ms = 0;
+    result.solve_ms = millisecondsSince(start);
+    result.counters = dfa.counters;
+    result.arena_bytes = dfa.arena.peak_bytes();
+    return result;
+  }
+
+  liveness::valueType livenessInitial(liveness::LivenessDFA& dfa){
+    return dfa.top;
+  }
+
+  reaching::valueType reachingInitial(reaching::ReachingDFA& dfa){
+    return dfa.top;
+  }
+
+  // Maypoint starts every block from the empty map, as the pass does
+  maypoint::valueType maypointInitial(maypoint::mayPoint& dfa){
+    dfa.context.budget.max_set_size = MaxSetSize;
+    return dfa.bottom();
+  }
+
+  runResult runAndersen(Function& F){
+    runResult result;
+    auto start = std::chrono::steady_clock::now();
+    maypoint::andersenSolver solver(F);
+    result.construct_ms = millisecondsSince(start);
+    start = std::chrono::steady_clock::now();
+    solver.solve();
+    result.solve_ms = millisecondsSince(start);
+    result.andersen = solver.counters;
+    result.arena_bytes = solver.arena.peak_bytes();
+    return result;
+  }
+
+  runResult runLivenessSparse(Function& F){
+    runResult result;
+    auto start = std::chrono::steady_clock::now();
+    liveness::LivenessSSA dfa(F);
+    blockState<liveness::valueType> state = dfa.initial_state(dfa.top);
+    result.construct_ms = millisecondsSince(start);
+    start = std::chrono::steady_clock::now();
+    dfa.run(state);
+    result.solve_ms = millisecondsSince(start);
+    result.counters = dfa.counters;
+    result.arena_bytes = dfa.arena.peak_bytes();
+    return result;
+  }
+
+  runResult runReachingCondensed(Function& F){
+    runResult result;
+    auto start = std::chrono::steady_clock::now();
+    reaching::ReachingDFA dfa(F);
+    blockState<reaching::valueType> state = dfa.initial_state(dfa.top);
+    result.construct_ms = millisecondsSince(start);
+    start = std::chrono::steady_clock::now();
+    dfa.run_condensed(state);
+    result.solve_ms = millisecondsSince(start);
+    result.counters = dfa.counters;
+    result.arena_bytes = dfa.arena.peak_bytes();
+    return result;
+  }
+
+  // Interference from every pair of values live together after some
+  // instruction, the instruction's own result included, or at the top of a
+  // block, its phis included. Edges are pairs of value numbers, the smaller
+  // first.
+  void naiveInterference(Function& F, liveness::LivenessDFA& dfa, blockState<liveness::valueType> state, DenseSet<std::pair<unsigned, unsigned>>& edges, unsigned& max_pressure){
+    instructionQuery<liveness::valueType> query = dfa.make_instruction_query(std::move(state));
+    std::vector<unsigned> live;
+    auto add_pairs = [&](){
+      for(unsigned x = 0; x < live.size(); x++){
+        for(unsigned y = x + 1; y < live.size(); y++){
+          edges.insert(std::make_pair(std::min(live[x], live[y]), std::max(live[x], live[y])));
+        }
+      }
+      max_pressure = std::max(max_pressure, (unsigned)live.size());
+    };
+    auto set_live = [&](const liveness::valueType& set){
+      live.clear();
+      for(unsigned bit = set.find_next(0); bit < dfa.numbering.size(); bit = set.find_next(bit + 1)){
+        live.push_back(bit);
+      }
+    };
+    for(BasicBlock& bb : F){
+      liveness::valueType after = query.fixed_point.out(&bb);
+      for(auto inst = bb.rbegin(); inst != bb.rend() && !isa<PHINode>(&*inst); ++inst){
+        set_live(after);
+        if(!inst->getType()->isVoidTy() && !after.count(&*inst)){
+          live.push_back(dfa.numbering.index(&*inst));
+        }
+        add_pairs();
+        after = query.valueAt(&*inst);
+      }
+      set_live(query.fixed_point.in(&bb));
+      for(PHINode& phi : bb.phis()){
+        if(!query.fixed_point.in(&bb).count(&phi)){
+          live.push_back(dfa.numbering.index(&phi));
+        }
+      }
+      add_pairs();
+    }
+  }
+
+  runResult runInterference(Function& F, bool naive){
+    runResult result;
+    auto start = std::chrono::steady_clock::now();
+    liveness::LivenessDFA dfa(F);
+    dfa.strategy = Solver;
+    dfa.threads = Threads;
+    blockState<liveness::valueType> state = dfa.initial_state(dfa.top);
+    dfa.run_dataflow(F, state);
+    result.construct_ms = millisecondsSince(start);
+    start = std::chrono::steady_clock::now();
+    if(naive){
+      DenseSet<std::pair<unsigned, unsigned>> edges;
+      naiveInterference(F, dfa, std::move(state), edges, result.max_pressure);
+      result.interferences = edges.size();
+    }
+    else{
+      liveness::interferenceGraph graph(dfa.numbering, state, (uint64_t)MatrixSize << 20);
+      result.interferences = graph.edge_count();
+      result.max_pressure = graph.max_pressure();
+      result.matrix = graph.uses_matrix();
+    }
+    result.solve_ms = millisecondsSince(start);
+    result.counters = dfa.counters;
+    result.arena_bytes = dfa.arena.peak_bytes();
+    return result;
+  }
+
+  instructionQuery<liveness::valueType> makeQuery(liveness::LivenessDFA& dfa, blockState<liveness::valueType> state){
+    return dfa.make_instruction_query(std::move(state));
+  }
+
+  instructionQuery<reaching::valueType> makeQuery(reaching::ReachingDFA& dfa, blockState<reaching::valueType> state){
+    return dfa.make_instruction_query(std::move(state));
+  }
+
+  instructionQuery<maypoint::valueType> makeQuery(maypoint::mayPoint& dfa, blockState<maypoint::valueType> state){
+    return dfa.makeInstructionQuery(std::move(state));
+  }
+
+  // Queries every instruction of F again and again after the solve, which
+  // must not grow the arena of the run: after the first pass, which may fill
+  // the query cache (Maypoint maps share chunks of the arena, recycled as
+  // the cache evicts blocks), it stays flat
+  template<typename DFA, typename T>
+  bool checkQueryArena(Function& F, T (*initial_of)(DFA&), json::OStream& record){
+    DFA dfa(F);
+    blockState<T> state = dfa.initial_state(initial_of(dfa));
+    dfa.run_dataflow(F, state);
+    record.attribute("solved_arena_kb", (int64_t)(dfa.arena.peak_bytes() / 1024));
+    instructionQuery<T> query = makeQuery(dfa, std::move(state));
+    auto query_all = [&](){
+      for(Instruction& inst : instructions(F)){
+        if(query.reports(&inst)){
+          query.valueAt(&inst);
+        }
+      }
+    };
+    query_all();
+    size_t first = dfa.arena.peak_bytes();
+    for(unsigned pass = 0; pass < 3; pass++){
+      query_all();
+    }
+    size_t repeated = dfa.arena.peak_bytes();
+    record.attribute("queried_arena_kb", (int64_t)(first / 1024));
+    record.attribute("requeried_arena_kb", (int64_t)(repeated / 1024));
+    return repeated == first;
+  }
+
+  // Pairs of values needing a register on which graph disagrees with
+  // interferes, a reference over the same values
+  uint64_t interferenceMismatches(const liveness::interferenceGraph& graph, const std::vector<Value*>& values, function_ref<bool(Value*, Value*)> interferes){
+    uint64_t mismatches = 0;
+    for(unsigned x = 0; x < values.size(); x++){
+      for(unsigned y = x + 1; y < values.size(); y++){
+        if(graph.interferes(values[x], values[y]) != interferes(values[x], values[y])){
+          mismatches++;
+        }
+      }
+    }
+    return mismatches;
+  }
+
+  // Builds the interference graph of F by the sweep, with the bit matrix and
+  // without it (which takes the deduplication in build_adjacency), and
+  // compares both with joining every pair of values live together
+  bool checkInterferenceNaive(Function& F, json::OStream& record){
+    liveness::LivenessDFA dfa(F);
+    blockState<liveness::valueType> state = dfa.initial_state(dfa.top);
+    dfa.run_dataflow(F, state);
+    liveness::interferenceGraph with_matrix(dfa.numbering, state);
+    liveness::interferenceGraph without_matrix(dfa.numbering, state, 0);
+    DenseSet<std::pair<unsigned, unsigned>> edges;
+    unsigned max_pressure = 0;
+    naiveInterference(F, dfa, std::move(state), edges, max_pressure);
+    auto naive_interferes = [&](Value* a, Value* b){
+      unsigned x = dfa.numbering.index(a), y = dfa.numbering.index(b);
+      return edges.count(std::make_pair(std::min(x, y), std::max(x, y))) != 0;
+    };
+    record.attribute("edges", (int64_t)edges.size());
+    record.attribute("max_pressure", (int64_t)max_pressure);
+    bool ok = true;
+    auto compare = [&](const liveness::interferenceGraph& graph, bool matrix, const char* key){
+      uint64_t mismatches = interferenceMismatches(graph, graph.nodes, naive_interferes);
+      bool same = graph.uses_matrix() == matrix && graph.edge_count() == edges.size() && graph.max_pressure() == max_pressure && mismatches == 0;
+      record.attribute(key, same);
+      ok &= same;
+    };
+    compare(with_matrix, true, "matrix");
+    compare(without_matrix, false, "adjacency");
+    return ok;
+  }
+
+  // Adds an unused copy of an instruction of F, solves liveness, removes the
+  // copy again and updates the result with reanalyze, leaving a hole in the
+  // numbering: the graph built from the update must match a fresh one
+  bool checkInterferenceUpdate(Function& F, json::OStream& record){
+    Instruction* original = nullptr;
+    for(Instruction& inst : instructions(F)){
+      if(!isa<PHINode>(&inst) && !inst.isTerminator() && !inst.getType()->isVoidTy() && !inst.mayHaveSideEffects()){
+        original = &inst;
+        break;
+      }
+    }
+    if(!original){
+      record.attribute("skipped", true);
+      return true;
+    }
+    Instruction* copy = original->clone();
+    copy->insertBefore(original);
+    liveness::LivenessDFA dfa(F);
+    blockState<liveness::valueType> state = dfa.initial_state(dfa.top);
+    dfa.run_dataflow(F, state);
+    unsigned nodes_with_copy = liveness::interferenceGraph(dfa.numbering, state).nodes.size();
+    BasicBlock* edited = copy->getParent();
+    copy->eraseFromParent();
+    dfa.reanalyze(F, state, {edited});
+    liveness::interferenceGraph updated(dfa.numbering, state);
+    liveness::LivenessDFA fresh_dfa(F);
+    blockState<liveness::valueType> fresh_state = fresh_dfa.initial_state(fresh_dfa.top);
+    fresh_dfa.run_dataflow(F, fresh_state);
+    liveness::interferenceGraph fresh(fresh_dfa.numbering, fresh_state);
+    uint64_t mismatches = interferenceMismatches(updated, fresh.nodes, [&](Value* a, Value* b){
+      return fresh.interferes(a, b);
+    });
+    record.attribute("nodes_with_copy", (int64_t)nodes_with_copy);
+    record.attribute("nodes", (int64_t)updated.nodes.size());
+    record.attribute("edges", (int64_t)updated.edge_count());
+    record.attribute("mismatches", (int64_t)mismatches);
+    return updated.nodes.size() == fresh.nodes.size() && nodes_with_copy == fresh.nodes.size() + 1 && updated.edge_count() == fresh.edge_count() && updated.max_pressure() == fresh.max_pressure() && mismatches == 0;
+  }
+
+  // Compares reaches(def, inst), answered from the condensed fixed point,
+  // with the set the query over the iterative one reports before inst, for
+  // every pair of instructions of F
+  bool checkReaches(Function& F, json::OStream& record){
+    reaching::ReachingDFA dfa(F);
+    blockState<reaching::valueType> state = dfa.initial_state(reachingInitial(dfa));
+    blockState<reaching::valueType> condensed = state;
+    dfa.run_dataflow(F, state);
+    dfa.run_condensed(condensed);
+    instructionQuery<reaching::valueType> query = dfa.make_instruction_query(std::move(state));
+    uint64_t pairs = 0, mismatches = 0;
+    for(Instruction& inst : instructions(F)){
+      if(!query.reports(&inst)){
+        continue;
+      }
+      const reaching::valueType& reported = query.valueAt(&inst);
+      for(Instruction& def : instructions(F)){
+        pairs++;
+        if(dfa.reaches(&def, &inst, condensed) != reported.count(&def)){
+          mismatches++;
+        }
+      }
+    }
+    record.attribute("pairs", (int64_t)pairs);
+    record.attribute("mismatches", (int64_t)mismatches);
+    return mismatches == 0;
+  }
+
+  // The points-to maps at the block boundaries of state, as printed
+  std::string printedFixedPoint(Function& F, blockState<maypoint::valueType>& state){
+    std::string text;
+    raw_string_ostream stream(text);
+    {
+      resultEmitter emitter(F, stream, FULL_OUTPUT);
+      for(BasicBlock& bb : F){
+        maypoint::print_lattice(emitter, state.in(&bb));
+        maypoint::print_lattice(emitter, state.out(&bb));
+      }
+    }
+    return stream.str();
+  }
+
+  // Re-solves every block of F with reanalyze under an evaluation budget
+  // that one solve of F fits in, after a solve that used it up and after
+  // one that ran out of it: each update must get the budget afresh and
+  // reach the unbounded fixed point
+  bool checkUpdateBudget(Function& F, json::OStream& record){
+    std::vector<BasicBlock*> all_blocks;
+    for(BasicBlock& bb : F){
+      all_blocks.push_back(&bb);
+    }
+    maypoint::mayPoint unbounded(F);
+    blockState<maypoint::valueType> expected_state = unbounded.initial_state(unbounded.bottom());
+    unbounded.run_dataflow(F, expected_state);
+    std::string expected = printedFixedPoint(F, expected_state);
+    maypoint::precisionBudget budget;
+    budget.max_evaluations = unbounded.counters.block_evaluations;
+    record.attribute("max_evaluations", (int64_t)budget.max_evaluations);
+    bool ok = true;
+    auto update_all = [&](maypoint::mayPoint& dfa, blockState<maypoint::valueType>& state, const char* key){
+      dfa.reanalyze(F, state, all_blocks);
+      bool same = !dfa.context.exhausted && printedFixedPoint(F, state) == expected;
+      record.attribute(key, same);
+      ok &= same;
+    };
+    maypoint::mayPoint used_up(F, budget);
+    blockState<maypoint::valueType> used_up_state = used_up.initial_state(used_up.bottom());
+    used_up.run_dataflow(F, used_up_state);
+    ok &= !used_up.context.exhausted;
+    update_all(used_up, used_up_state, "after_full_budget");
+    update_all(used_up, used_up_state, "after_update");
+    maypoint::precisionBudget small = budget;
+    small.max_evaluations = 1;
+    maypoint::mayPoint ran_out(F, small);
+    blockState<maypoint::valueType> ran_out_state = ran_out.initial_state(ran_out.bottom());
+    ran_out.run_dataflow(F, ran_out_state);
+    record.attribute("first_exhausted", ran_out.context.exhausted);
+    ran_out.context.budget = budget;
+    update_all(ran_out, ran_out_state, "after_exhausted");
+    return ok;
+  }
+
+  // Runs the checks of -verify on F, reporting whether all passed
+  bool verifyFunctionResults(shapeKind shape, unsigned size, Function& F){
+    bool all_ok = true;
+    auto check = [&](const char* name, const char* analysis, function_ref<bool(json::OStream&)> run){
+      json::OStream record(outs());
+      record.object([&](){
+        record.attribute("shape", shapeName(shape));
+        record.attribute("size", (int64_t)size);
+        record.attribute("check", name);
+        record.attribute("analysis", analysis);
+        bool ok = run(record);
+        record.attribute("ok", ok);
+        all_ok &= ok;
+      });
+      outs() << "\n";
+      outs().flush();
+    };
+    check("query-arena", "liveness", [&](json::OStream& record){
+      return checkQueryArena<liveness::LivenessDFA, liveness::valueType>(F, livenessInitial, record);
+    });
+    check("query-arena", "reaching", [&](json::OStream& record){
+      return checkQueryArena<reaching::ReachingDFA, reaching::valueType>(F, reachingInitial, record);
+    });
+    check("reaches", "reaching", [&](json::OStream& record){
+      return checkReaches(F, record);
+    });
+    check("interference-naive", "interference", [&](json::OStream& record){
+      return checkInterferenceNaive(F, record);
+    });
+    check("interference-update", "interference", [&](json::OStream& record){
+      return checkInterferenceUpdate(F, record);
+    });
+    check("query-arena", "maypoint", [&](json::OStream& record){
+      return checkQueryArena<maypoint::mayPoint, maypoint::valueType>(F, maypointInitial, record);
+    });
+    check("update-budget", "maypoint", [&](json::OStream& record){
+      return checkUpdateBudget(F, record);
+    });
+    return all_ok;
+  }
+
+  bool hasReanalysis(analysisKind analysis){
+    return analysis == LIVENESS || analysis == REACHING || analysis == MAYPOINT;
+  }
+
+  runResult runReanalysisOf(analysisKind analysis, Function& F){
+    switch(analysis){
+      case LIVENESS: return runReanalysis<liveness::LivenessDFA, liveness::valueType>(F, livenessInitial);
+      case REACHING: return runReanalysis<reaching::ReachingDFA, reaching::valueType>(F, reachingInitial);
+      case MAYPOINT: return runReanalysis<maypoint::mayPoint, maypoint::valueType>(F, maypointInitial);
+      default: break;
+    }
+    llvm_unreachable("No incremental mode for this analysis");
+  }
+
+  runResult runAnalysis(analysisKind analysis, Function& F){
+    switch(analysis){
+      case LIVENESS: return runSolver<liveness::LivenessDFA, liveness::valueType>(F, livenessInitial);
+      case LIVENESS_SPARSE: return runLivenessSparse(F);
+      case REACHING: return runSolver<reaching::ReachingDFA, reaching::valueType>(F, reachingInitial);
+      case REACHING_CONDENSED: return runReachingCondensed(F);
+      case MAYPOINT: return runSolver<maypoint::mayPoint, maypoint::valueType>(F, maypointInitial);
+      case ANDERSEN: return runAndersen(F);
+      case INTERFERENCE: return runInterference(F, false);
+      case INTERFERENCE_NAIVE: return runInterference(F, true);
+    }
+    llvm_unreachable("Unknown analysis");
+  }
+}
+
+int main(int argc, char** argv){
+  InitLLVM X(argc, argv);
+  cl::ParseCommandLineOptions(argc, argv, "Dataflow solver benchmark\n");
+  std::vector<shapeKind> shapes(Shapes.begin(), Shapes.end());
+  if(shapes.empty()){
+    shapes = {LOOPS, DIAMONDS, SWITCH, STRAIGHT, PHIS, POINTERS, WIDE, LOOP_SWITCH, WINDOW};
+  }
+  std::vector<analysisKind> analyses(Analyses.begin(), Analyses.end());
+  if(analyses.empty()){
+    analyses = {LIVENESS, LIVENESS_SPARSE, REACHING, REACHING_CONDENSED, MAYPOINT, ANDERSEN, INTERFERENCE, INTERFERENCE_NAIVE};
+  }
+  std::vector<unsigned> sizes(Sizes.begin(), Sizes.end());
+  if(sizes.empty()){
+    sizes = {16, 256};
+  }
+
+  LLVMContext context;
+  Module M("dataflow-benchmark", context);
+  cfgGenerator generator(M);
+  bool verified = true;
+  for(shapeKind shape : shapes){
+    for(unsigned size : sizes){
+      Function* F = generator.generate(shape, size);
+      if(verifyFunction(*F, &errs())){
+        errs() << "Generated function " << F->getName() << " is invalid\n";
+        return 1;
+      }
+      if(DumpIR){
+        F->print(errs());
+      }
+      if(Verify){
+        verified &= verifyFunctionResults(shape, size, *F);
+        continue;
+      }
+      for(analysisKind analysis : analyses){
+        runResult best;
+        for(unsigned run = 0; run < std::max(1u, (unsigned)Repeat); run++){
+          runResult result = runAnalysis(analysis, *F);
+          if(run == 0 || result.construct_ms + result.solve_ms < best.construct_ms + best.solve_ms){
+            best = result;
+          }
+        }
+        json::OStream record(outs());
+        record.object([&](){
+          record.attribute("shape", shapeName(shape));
+          record.attribute("size", (int64_t)size);
+          record.attribute("blocks", (int64_t)F->size());
+          record.attribute("instructions", (int64_t)F->getInstructionCount());
+          record.attribute("analysis", analysisName(analysis));
+          record.attribute("solver", solverName(Solver));
+          record.attribute("construct_ms", best.construct_ms);
+          record.attribute("solve_ms", best.solve_ms);
+          record.attribute("wall_ms", best.construct_ms + best.solve_ms);
+          if(analysis == ANDERSEN){
+            record.attribute("propagations", (int64_t)best.andersen.propagations);
+            record.attribute("copy_edges", (int64_t)best.andersen.copy_edges);
+            record.attribute("collapsed", (int64_t)best.andersen.collapsed);
+          }
+          else{
+            record.attribute("iterations", (int64_t)best.counters.iterations);
+            record.attribute("block_evaluations", (int64_t)best.counters.block_evaluations);
+            record.attribute("meets", (int64_t)best.counters.meets);
+          }
+          if(analysis == INTERFERENCE || analysis == INTERFERENCE_NAIVE){
+            record.attribute("interferences", (int64_t)best.interferences);
+            record.attribute("max_pressure", (int64_t)best.max_pressure);
+          }
+          if(analysis == INTERFERENCE){
+            record.attribute("matrix", best.matrix);
+          }
+          if(analysis == MAYPOINT && MaxSetSize){
+            record.attribute("collapsed_sets", (int64_t)best.collapsed_sets);
+          }
+          record.attribute("arena_kb", (int64_t)(best.arena_bytes / 1024));
+          record.attribute("peak_rss_kb", (int64_t)peakRSSKilobytes());
+        });
+        outs() << "\n";
+        outs().flush();
+        if(!Reanalyze || !hasReanalysis(analysis)){
+          continue;
+        }
+        Function* copy = generator.generate(shape, size);
+        runResult incremental = runReanalysisOf(analysis, *copy);
+        json::OStream incremental_record(outs());
+        incremental_record.object([&](){
+          incremental_record.attribute("shape", shapeName(shape));
+          incremental_record.attribute("size", (int64_t)size);
+          incremental_record.attribute("blocks", (int64_t)copy->size());
+          incremental_record.attribute("analysis", analysisName(analysis));
+          incremental_record.attribute("edit", "split-edge");
+          incremental_record.attribute("reanalyze_ms", incremental.solve_ms);
+          incremental_record.attribute("block_evaluations", (int64_t)incremental.counters.block_evaluations);
+        });
+        outs() << "\n";
+        outs().flush();
+        copy->eraseFromParent();
+      }
+    }
+  }
+  return verified ? 0 : 1;
+}
@@ -1,93 +1,2339 @@
+#ifndef LLVM_ANALYSIS_DATAFLOW_H
+#define LLVM_ANALYSIS_DATAFLOW_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/ModuleSlotTracker.h"
+#include "llvm/IR/PassTimingInfo.h"
 #include "llvm/Pass.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/IR/CFG.h" // For iterating over predecessors of a basic block
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/Allocator.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/LEB128.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/TimeProfiler.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/Threading.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <list>
+#include <iterator>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <scoped_allocator>
 #include <set>
+#include <string>
+#include <vector>
 
 using namespace llvm;
 
+// How run_dataflow schedules block evaluations.
+// ROUND_ROBIN sweeps every block in layout order until nothing changes.
+// WORKLIST only revisits blocks whose inputs changed, in reverse post-order
+// for forward problems and post-order for backward ones.
+enum solverStrategy { ROUND_ROBIN, WORKLIST, COMPONENTS };
+
+// Values for a per-pass cl::opt<solverStrategy>. Every pass plugin registers
+// its own option name so that several of them can be loaded into one opt.
+inline cl::ValuesClass solverStrategyValues(){
+  return cl::values(clEnumValN(ROUND_ROBIN, "round-robin", "Sweep all blocks until no change"),
+                    clEnumValN(WORKLIST, "worklist", "Revisit only blocks whose inputs changed"),
+                    clEnumValN(COMPONENTS, "components", "Worklist per strongly connected component of the CFG, independent components solved in parallel"));
+}
+
+// What a pass prints for each function.
+enum outputMode { FULL_OUTPUT, SUMMARY_OUTPUT, JSON_OUTPUT, NO_OUTPUT };
+
+// Values for a per-pass cl::opt<outputMode>
+inline cl::ValuesClass outputModeValues(){
+  return cl::values(clEnumValN(FULL_OUTPUT, "full", "The function, then the result at every instruction"),
+                    clEnumValN(SUMMARY_OUTPUT, "summary", "Only the IN and OUT of every block"),
+                    clEnumValN(JSON_OUTPUT, "json", "One JSON object per line for every instruction"),
+                    clEnumValN(NO_OUTPUT, "none", "Nothing, for timing the analysis"));
+}
+
+// Numbers the arguments and instructions of a function once, so that sets of
+// them can be stored as bitvectors. Arguments come first, then instructions
+// in layout order.
+class valueNumbering{
+  public:
+    std::vector<Value*> values;
+    DenseMap<Value*, unsigned> indices;
+
+    void init(Function &F){
+      values.clear();
+      indices.clear();
+      for(auto arg = F.arg_begin(); arg != F.arg_end(); ++arg){
+        indices[(Value*)&*arg] = values.size();
+        values.push_back((Value*)&*arg);
+      }
+      for(auto&& bb : F.getBasicBlockList()){
+        for(auto&& inst : bb){
+          indices[(Value*)&inst] = values.size();
+          values.push_back((Value*)&inst);
+        }
+      }
+    }
+
+    unsigned size() const{
+      return values.size();
+    }
+
+    unsigned index(Value* v) const{
+      auto it = indices.find(v);
+      assert(it != indices.end() && "Value is not numbered in this function");
+      return it->second;
+    }
+
+    // Brings the numbering up to date after F was edited. Surviving values
+    // keep their numbers, so sets over the old numbering stay meaningful;
+    // new values are numbered at the end, and values that are gone leave a
+    // null hole. Returns the numbers of the values that are gone.
+    std::vector<unsigned> update(Function &F){
+      std::vector<bool> present(values.size(), false);
+      auto visit = [&](Value* v){
+        auto inserted = indices.insert(std::make_pair(v, (unsigned)values.size()));
+        if(inserted.second){
+          values.push_back(v);
+        }
+        else{
+          present[inserted.first->second] = true;
+        }
+      };
+      for(auto arg = F.arg_begin(); arg != F.arg_end(); ++arg){
+        visit((Value*)&*arg);
+      }
+      for(auto&& bb : F.getBasicBlockList()){
+        for(auto&& inst : bb){
+          visit((Value*)&inst);
+        }
+      }
+      std::vector<unsigned> retired;
+      for(unsigned idx = 0; idx < present.size(); idx++){
+        if(!present[idx] && values[idx]){
+          indices.erase(values[idx]);
+          values[idx] = nullptr;
+          retired.push_back(idx);
+        }
+      }
+      return retired;
+    }
+
+    // Number of v, numbering it now if init did not (e.g. a global)
+    unsigned number(Value* v){
+      auto inserted = indices.insert(std::make_pair(v, (unsigned)values.size()));
+      if(inserted.second){
+        values.push_back(v);
+      }
+      return inserted.first->second;
+    }
+};
+
+// Bump allocator holding the lattice storage of one analysis run. Containers
+// allocated from it never free individually; everything is released at once
+// by release() or when the arena is destroyed, so every lattice value using it
+// must be dead by then.
+class latticeArena{
+  public:
+    void* allocate(size_t size, size_t alignment){
+      if(shared){
+        std::lock_guard<std::mutex> lock(mutex);
+        return allocator.Allocate(size, Align(alignment));
+      }
+      return allocator.Allocate(size, Align(alignment));
+    }
+
+    // While set, allocate may be called from several threads at once
+    void set_shared(bool value){
+      shared = value;
+    }
+
+    // Bytes reserved from the system, including slab slack
+    size_t peak_bytes() const{
+      return std::max(peak, allocator.getTotalMemory());
+    }
+
+    void release(){
+      peak = peak_bytes();
+      allocator.Reset();
+    }
+
+  private:
+    BumpPtrAllocator allocator;
+    size_t peak = 0;
+    bool shared = false;
+    std::mutex mutex;
+};
+
+// STL allocator over a latticeArena. Without an arena it falls back to the
+// heap, so default constructed lattice values keep working. Copy construction
+// keeps the arena of the source, so the states of a solve share its arena, but
+// copy assignment keeps the destination's allocator: a heap value assigned
+// from arena storage (the instruction query cache, a block walker's current
+// value) stays on the heap and is freed with it, instead of growing the arena
+// of the run on every query.
+template<typename U>
+class arenaAllocator{
+  public:
+    typedef U value_type;
+    typedef std::false_type propagate_on_container_copy_assignment;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+    latticeArena* arena;
+
+    arenaAllocator(latticeArena* arena = nullptr) noexcept : arena(arena) {}
+    template<typename W>
+    arenaAllocator(const arenaAllocator<W>& other) noexcept : arena(other.arena) {}
+
+    U* allocate(size_t n){
+      if(arena){
+        return static_cast<U*>(arena->allocate(n * sizeof(U), alignof(U)));
+      }
+      return static_cast<U*>(::operator new(n * sizeof(U)));
+    }
+
+    void deallocate(U* p, size_t n){
+      if(!arena){
+        ::operator delete(p);
+      }
+    }
+
+    template<typename W>
+    bool operator == (const arenaAllocator<W>& other) const{
+      return arena == other.arena;
+    }
+
+    template<typename W>
+    bool operator != (const arenaAllocator<W>& other) const{
+      return arena != other.arena;
+    }
+};
+
+// A set of numbered values stored as a packed bitvector. Meet is a word-wise
+// OR and equality a memcmp. A default constructed set has no numbering and
+// behaves as the empty set.
+template<typename V>
+class bitVectorSet{
+  public:
+    typedef uint64_t word;
+    static const unsigned word_bits = 64;
+    const valueNumbering* numbering;
+    std::vector<word, arenaAllocator<word>> words;
+
+    bitVectorSet() : numbering(nullptr) {}
+    explicit bitVectorSet(const valueNumbering* numbering, latticeArena* arena = nullptr) : numbering(numbering), words((numbering->size() + word_bits - 1) / word_bits, 0, arenaAllocator<word>(arena)) {}
+
+    class iterator{
+      public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef V value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const V* pointer;
+        typedef V reference;
+        iterator(const bitVectorSet* set, unsigned bit) : set(set), bit(bit) {}
+        V operator*() const{
+          return static_cast<V>(set->numbering->values[bit]);
+        }
+        iterator& operator++(){
+          bit = set->find_next(bit + 1);
+          return *this;
+        }
+        bool operator==(const iterator& other) const{
+          return bit == other.bit;
+        }
+        bool operator!=(const iterator& other) const{
+          return bit != other.bit;
+        }
+      private:
+        const bitVectorSet* set;
+        unsigned bit;
+    };
+
+    iterator begin() const{
+      return iterator(this, find_next(0));
+    }
+
+    iterator end() const{
+      return iterator(this, words.size() * word_bits);
+    }
+
+    // Index of the first set bit at or after from, or end position
+    unsigned find_next(unsigned from) const{
+      unsigned idx = from / word_bits;
+      if(idx >= words.size()){
+        return words.size() * word_bits;
+      }
+      word current = words[idx] & (~word(0) << (from % word_bits));
+      while(current == 0){
+        if(++idx == words.size()){
+          return words.size() * word_bits;
+        }
+        current = words[idx];
+      }
+      return idx * word_bits + countTrailingZeros(current);
+    }
+
+    void insert(V v){
+      unsigned bit = numbering->index(v);
+      words[bit / word_bits] |= word(1) << (bit % word_bits);
+    }
+
+    // Sets bit idx, reporting whether it was clear
+    bool test_and_set(unsigned idx){
+      word mask = word(1) << (idx % word_bits);
+      word& w = words[idx / word_bits];
+      bool was_clear = !(w & mask);
+      w |= mask;
+      return was_clear;
+    }
+
+    void erase(V v){
+      if(words.empty()){
+        return;
+      }
+      unsigned bit = numbering->index(v);
+      words[bit / word_bits] &= ~(word(1) << (bit % word_bits));
+    }
+
+    bool count(V v) const{
+      if(words.empty()){
+        return false;
+      }
+      unsigned bit = numbering->index(v);
+      return (words[bit / word_bits] >> (bit % word_bits)) & 1;
+    }
+
+    unsigned size() const{
+      unsigned result = 0;
+      for(word w : words){
+        result += countPopulation(w);
+      }
+      return result;
+    }
+
+    bool empty() const{
+      for(word w : words){
+        if(w){
+          return false;
+        }
+      }
+      return true;
+    }
+
+    // this = this U b
+    void unite(const bitVectorSet& b){
+      if(words.size() < b.words.size()){
+        words.resize(b.words.size(), 0);
+        numbering = b.numbering;
+      }
+      for(unsigned idx = 0; idx < b.words.size(); idx++){
+        words[idx] |= b.words[idx];
+      }
+    }
+
+    // this = this U b, reporting whether any element was added
+    bool join(const bitVectorSet& b){
+      if(words.size() < b.words.size()){
+        words.resize(b.words.size(), 0);
+        numbering = b.numbering;
+      }
+      word added = 0;
+      for(unsigned idx = 0; idx < b.words.size(); idx++){
+        added |= b.words[idx] & ~words[idx];
+        words[idx] |= b.words[idx];
+      }
+      return added != 0;
+    }
+
+    // this = this - b
+    void subtract(const bitVectorSet& b){
+      unsigned common = std::min(words.size(), b.words.size());
+      for(unsigned idx = 0; idx < common; idx++){
+        words[idx] &= ~b.words[idx];
+      }
+    }
+
+    // this = this - b, reporting whether any element was removed
+    bool erase_all(const bitVectorSet& b){
+      unsigned common = std::min(words.size(), b.words.size());
+      word removed = 0;
+      for(unsigned idx = 0; idx < common; idx++){
+        removed |= words[idx] & b.words[idx];
+        words[idx] &= ~b.words[idx];
+      }
+      return removed != 0;
+    }
+
+    bitVectorSet operator ^ (const bitVectorSet& b) const{
+      const bitVectorSet& wider = words.size() >= b.words.size() ? *this : b;
+      const bitVectorSet& narrower = words.size() >= b.words.size() ? b : *this;
+      bitVectorSet result(wider);
+      result.unite(narrower);
+      return result;
+    }
+
+    bool operator == (const bitVectorSet& b) const{
+      if(words.size() == b.words.size()){
+        return words.empty() || std::memcmp(words.data(), b.words.data(), words.size() * sizeof(word)) == 0;
+      }
+      // One side is a default constructed empty set
+      return empty() && b.empty();
+    }
+
+    bool operator != (const bitVectorSet& b) const{
+      return !(*this == b);
+    }
+};
+
+// In-place meet used by the solver: dst = dst ^ src, returning whether dst
+// changed. Lattice types of a pass provide an overload found by ADL.
+template<typename V>
+bool joinInto(bitVectorSet<V>& dst, const bitVectorSet<V>& src){
+  return dst.join(src);
+}
+
+// Number of elements, for statistics
+template<typename V>
+unsigned lattice_size(const bitVectorSet<V>& value){
+  return value.size();
+}
+
+// Whether the solver may update the values of different blocks from several
+// threads at once. Lattice types whose values share mutable state (an
+// interning table, say) keep the default.
+template<typename T>
+struct concurrentLattice{
+  static constexpr bool value = false;
+};
+
+template<typename V>
+struct concurrentLattice<bitVectorSet<V>>{
+  static constexpr bool value = true;
+};
+
+// Transfer function of a bit-vector problem summarized as
+// out = gen U (in - kill). The summary is built by replaying, in the order the
+// analysis walks the code, the same remove/add steps the per-instruction
+// transfer would perform.
+template<typename T, typename V>
+class genKillSummary{
+  public:
+    T gen;
+    T kill;
+    genKillSummary(){}
+    explicit genKillSummary(const T& empty) : gen(empty), kill(empty) {}
+
+    void remove(V v){
+      gen.erase(v);
+      kill.insert(v);
+    }
+
+    void add(V v){
+      gen.insert(v);
+    }
+
+    void apply(const T& in, T& out) const{
+      out = in;
+      out.subtract(kill);
+      out.unite(gen);
+    }
+};
+
+// Dense numbering of the basic blocks of a function in layout order. Solver
+// state and transfer functions are indexed by this number.
+class blockNumbering{
+  public:
+    std::vector<BasicBlock*> blocks;
+    DenseMap<BasicBlock*, unsigned> indices;
+
+    void init(Function &F){
+      blocks.clear();
+      indices.clear();
+      for(auto&& bb : F.getBasicBlockList()){
+        indices[&bb] = blocks.size();
+        blocks.push_back(&bb);
+      }
+    }
+
+    unsigned size() const{
+      return blocks.size();
+    }
+
+    unsigned index(BasicBlock* bb) const{
+      auto it = indices.find(bb);
+      assert(it != indices.end() && "Block is not numbered in this function");
+      return it->second;
+    }
+};
+
+// CFG of a function captured once before solving. Blocks are dense indices and
+// edges are stored in compressed sparse row form, so that a solver step walks
+// flat arrays instead of use lists. An edge is numbered by its position in the
+// predecessor array; duplicate edges (e.g. switch cases with the same target)
+// are kept, matching predecessors()/successors(). For every edge the snapshot
+// also records the value each phi node of the target takes along it.
+class cfgSnapshot : public blockNumbering{
+  public:
+    std::vector<unsigned> pred_begin; // Offsets into preds, one past the end for the last block
+    std::vector<unsigned> preds; // Source block of each edge
+    std::vector<unsigned> succ_begin; // Offsets into succs and succ_edges
+    std::vector<unsigned> succs; // Target block of each outgoing edge
+    std::vector<unsigned> succ_edges; // Edge number of each outgoing edge
+    std::vector<unsigned> phi_begin; // Offsets into phis
+    std::vector<PHINode*> phis; // Phi nodes of each block in order
+    std::vector<unsigned> incoming_begin; // Offset of each edge into incoming
+    std::vector<Value*> incoming; // Per edge, one value for each phi of the target
+
+    void init(Function &F){
+      blockNumbering::init(F);
+      unsigned count = size();
+      pred_begin.assign(1, 0);
+      preds.clear();
+      phi_begin.assign(1, 0);
+      phis.clear();
+      for(BasicBlock* bb : blocks){
+        for(BasicBlock* pred : llvm::predecessors(bb)){
+          preds.push_back(index(pred));
+        }
+        pred_begin.push_back(preds.size());
+        for(PHINode& phi : bb->phis()){
+          phis.push_back(&phi);
+        }
+        phi_begin.push_back(phis.size());
+      }
+      // The k-th edge from a block to a target is matched with the k-th
+      // occurrence of the block among the target's predecessors
+      std::vector<bool> matched(preds.size(), false);
+      succ_begin.assign(1, 0);
+      succs.clear();
+      succ_edges.clear();
+      for(unsigned idx = 0; idx < count; idx++){
+        for(BasicBlock* succ : llvm::successors(blocks[idx])){
+          unsigned succ_idx = index(succ);
+          unsigned edge = pred_begin[succ_idx];
+          while(preds[edge] != idx || matched[edge]){
+            edge++;
+          }
+          matched[edge] = true;
+          succs.push_back(succ_idx);
+          succ_edges.push_back(edge);
+        }
+        succ_begin.push_back(succs.size());
+      }
+      incoming_begin.clear();
+      incoming.clear();
+      for(unsigned idx = 0; idx < count; idx++){
+        for(unsigned edge = pred_begin[idx]; edge < pred_begin[idx + 1]; edge++){
+          incoming_begin.push_back(incoming.size());
+          for(PHINode* phi : phi_nodes(idx)){
+            incoming.push_back(phi->getIncomingValueForBlock(blocks[preds[edge]]));
+          }
+        }
+      }
+      incoming_begin.push_back(incoming.size());
+    }
+
+    unsigned edge_count() const{
+      return preds.size();
+    }
+
+    ArrayRef<unsigned> succ_indices(unsigned idx) const{
+      return makeArrayRef(succs).slice(succ_begin[idx], succ_begin[idx + 1] - succ_begin[idx]);
+    }
+
+    ArrayRef<unsigned> pred_indices(unsigned idx) const{
+      return makeArrayRef(preds).slice(pred_begin[idx], pred_begin[idx + 1] - pred_begin[idx]);
+    }
+
+    ArrayRef<PHINode*> phi_nodes(unsigned idx) const{
+      return makeArrayRef(phis).slice(phi_begin[idx], phi_begin[idx + 1] - phi_begin[idx]);
+    }
+
+    // Incoming values along edge, parallel to phi_nodes of its target
+    ArrayRef<Value*> incoming_values(unsigned edge) const{
+      return makeArrayRef(incoming).slice(incoming_begin[edge], incoming_begin[edge + 1] - incoming_begin[edge]);
+    }
+};
+
+// Strongly connected components of a cfgSnapshot, numbered in topological
+// order: an edge between two components always goes from a lower to a higher
+// number. Every block is covered, including blocks unreachable from the entry.
+class cfgComponents{
+  public:
+    std::vector<unsigned> component; // Of each block
+    std::vector<unsigned> member_begin; // Offsets into members
+    std::vector<unsigned> members; // Blocks of each component in layout order
+    std::vector<bool> cyclic; // Has an edge inside: several blocks or a self loop
+
+    void init(const cfgSnapshot& cfg){
+      unsigned count = cfg.size();
+      const unsigned unvisited = ~0u;
+      std::vector<unsigned> index(count, unvisited);
+      std::vector<unsigned> low(count, 0);
+      std::vector<bool> on_stack(count, false);
+      std::vector<unsigned> component_stack;
+      std::vector<std::pair<unsigned,unsigned>> call_stack; // Block, next outgoing edge
+      std::vector<std::vector<unsigned>> found; // In reverse topological order
+      unsigned next_index = 0;
+      for(unsigned root = 0; root < count; root++){
+        if(index[root] != unvisited){
+          continue;
+        }
+        index[root] = low[root] = next_index++;
+        component_stack.push_back(root);
+        on_stack[root] = true;
+        call_stack.emplace_back(root, cfg.succ_begin[root]);
+        while(!call_stack.empty()){
+          unsigned block = call_stack.back().first;
+          unsigned& pos = call_stack.back().second;
+          if(pos < cfg.succ_begin[block + 1]){
+            unsigned succ = cfg.succs[pos++];
+            if(index[succ] == unvisited){
+              index[succ] = low[succ] = next_index++;
+              component_stack.push_back(succ);
+              on_stack[succ] = true;
+              call_stack.emplace_back(succ, cfg.succ_begin[succ]);
+            }
+            else if(on_stack[succ]){
+              low[block] = std::min(low[block], index[succ]);
+            }
+            continue;
+          }
+          call_stack.pop_back();
+          if(!call_stack.empty()){
+            unsigned parent = call_stack.back().first;
+            low[parent] = std::min(low[parent], low[block]);
+          }
+          if(low[block] == index[block]){
+            found.emplace_back();
+            unsigned member;
+            do{
+              member = component_stack.back();
+              component_stack.pop_back();
+              on_stack[member] = false;
+              found.back().push_back(member);
+            } while(member != block);
+          }
+        }
+      }
+      component.assign(count, 0);
+      member_begin.assign(1, 0);
+      members.clear();
+      cyclic.clear();
+      for(auto it = found.rbegin(); it != found.rend(); ++it){
+        std::sort(it->begin(), it->end());
+        bool has_cycle = it->size() > 1;
+        for(unsigned block : *it){
+          component[block] = cyclic.size();
+          members.push_back(block);
+          for(unsigned succ : cfg.succ_indices(block)){
+            has_cycle |= succ == block;
+          }
+        }
+        member_begin.push_back(members.size());
+        cyclic.push_back(has_cycle);
+      }
+    }
+
+    unsigned size() const{
+      return cyclic.size();
+    }
+
+    ArrayRef<unsigned> blocks_of(unsigned idx) const{
+      return makeArrayRef(members).slice(member_begin[idx], member_begin[idx + 1] - member_begin[idx]);
+    }
+};
+
+// IN and OUT of one basic block, kept side by side
+template<typename T>
+struct blockValues{
+  T in;
+  T out;
+};
+
+// Solver state of one function: IN/OUT of every block stored contiguously and
+// indexed by block number.
+template<typename T>
+class blockState{
+  public:
+    const blockNumbering* numbering;
+    std::vector<blockValues<T>> values;
+
+    blockState() : numbering(nullptr) {}
+    blockState(const blockNumbering* numbering, const T& initial) : numbering(numbering), values(numbering->size(), blockValues<T>{initial, initial}) {}
+
+    T& in(unsigned idx){
+      return values[idx].in;
+    }
+
+    T& out(unsigned idx){
+      return values[idx].out;
+    }
+
+    T& in(BasicBlock* bb){
+      return values[numbering->index(bb)].in;
+    }
+
+    T& out(BasicBlock* bb){
+      return values[numbering->index(bb)].out;
+    }
+};
+
+// Transfer functions read their input by reference and write their result
+// into a buffer owned by the caller, so that the solver can reuse storage.
+template<typename T>
+using transferFunctionType = std::function<void(const T&, T&)>;
+
+// Work done by one run_dataflow call
+struct solverCounters{
+  unsigned long iterations = 0; // Sweeps over the blocks; for the worklist, passes in visit order
+  unsigned long block_evaluations = 0;
+  unsigned long transfer_calls = 0; // Block and phi edge transfer functions applied
+  unsigned long meets = 0; // Edge values joined into a block's meet
+  unsigned long changes = 0; // Block INs and OUTs that grew
+
+  solverCounters& operator+=(const solverCounters& other){
+    iterations += other.iterations;
+    block_evaluations += other.block_evaluations;
+    transfer_calls += other.transfer_calls;
+    meets += other.meets;
+    changes += other.changes;
+    return *this;
+  }
+};
+
+// Adds the counters of one run to the statistics printed by -stats. The
+// statistics are function-local statics of an inline function so that every
+// analysis built from this header shares one set.
+inline void record_solver_statistics(const solverCounters& counters, uint64_t set_size_sum, uint64_t set_size_samples, uint64_t max_set_size){
+  static Statistic NumIterations = {"dataflow", "NumIterations", "Solver iterations to reach a fixed point"};
+  static Statistic NumBlockEvaluations = {"dataflow", "NumBlockEvaluations", "Basic blocks evaluated by the solver"};
+  static Statistic NumTransferCalls = {"dataflow", "NumTransferCalls", "Block and phi edge transfer functions applied"};
+  static Statistic NumMeets = {"dataflow", "NumMeets", "Edge values joined into a meet"};
+  static Statistic NumLatticeChanges = {"dataflow", "NumLatticeChanges", "Block INs and OUTs that changed"};
+  static Statistic MaxSetSize = {"dataflow", "MaxSetSize", "Largest lattice value at a block boundary"};
+  static Statistic AvgSetSize = {"dataflow", "AvgSetSize", "Average lattice value size at block boundaries"};
+  static std::atomic<uint64_t> total_set_size(0);
+  static std::atomic<uint64_t> total_samples(0);
+  NumIterations += counters.iterations;
+  NumBlockEvaluations += counters.block_evaluations;
+  NumTransferCalls += counters.transfer_calls;
+  NumMeets += counters.meets;
+  NumLatticeChanges += counters.changes;
+  MaxSetSize.updateMax(max_set_size);
+  uint64_t samples = total_samples += set_size_samples;
+  uint64_t size_sum = total_set_size += set_size_sum;
+  if(samples){
+    AvgSetSize = size_sum / samples;
+  }
+}
+
+inline void record_arena_statistics(const latticeArena& arena){
+  static Statistic MaxArenaBytes = {"dataflow", "MaxArenaBytes", "Largest lattice arena of one analysis run"};
+  MaxArenaBytes.updateMax(arena.peak_bytes());
+}
+
+// True on the worker threads of run_on_functions_in_parallel
+inline bool& in_parallel_worker(){
+  static thread_local bool worker = false;
+  return worker;
+}
+
+// Times one phase of an analysis. Reported in the "dataflow" group under
+// -time-passes and as a scope in -time-trace output. Timers are shared
+// between functions, so they are not started on parallel worker threads.
+class phaseTimer{
+  public:
+    phaseTimer(StringRef name, StringRef description){
+      if(TimePassesIsEnabled && !in_parallel_worker()){
+        timer.emplace(name, description, "dataflow", "Dataflow analysis phases");
+      }
+      trace.emplace(description);
+    }
+
+    void stop(){
+      timer.reset();
+      trace.reset();
+    }
+
+  private:
+    Optional<NamedRegionTimer> timer;
+    Optional<TimeTraceScope> trace;
+};
+
+// Runtime-configured transfer functions of one block, used by dataFlow. The
+// phi edge transfers are keyed by predecessor.
 template<typename T>
 class transferFunction{
   public: 
     bool has_phi_nodes;
-    bool is_forward;
-    std::map<BasicBlock*, std::function<T(T)>> transferMap; // One for each of the predecessors if phi nodes exist
-    std::map<BasicBlock*, transferFunction>* blockToTransferFunctionsMap;  // Pointer to map of BasicBlock* to transferFunction*
-    std::function<T(T)> blockTransferFunction;
+    std::map<BasicBlock*, transferFunctionType<T>> transferMap; // One for each of the predecessors if phi nodes exist
+    transferFunctionType<T> blockTransferFunction;
     BasicBlock* basic_block;
-    T top;
     transferFunction(){
       has_phi_nodes = false;
     };
 
-    transferFunction(bool is_forward, std::map<BasicBlock*, std::function<T(T)>> transferMap, std::function<T(T)> blockTransferFunction, BasicBlock* basic_block) : has_phi_nodes(true), is_forward(is_forward), transferMap(transferMap), blockTransferFunction(blockTransferFunction), basic_block(basic_block) {};
+    transferFunction(std::map<BasicBlock*, transferFunctionType<T>> transferMap, transferFunctionType<T> blockTransferFunction, BasicBlock* basic_block) : has_phi_nodes(true), transferMap(std::move(transferMap)), blockTransferFunction(std::move(blockTransferFunction)), basic_block(basic_block) {};
+
+    transferFunction(transferFunctionType<T> blockTransferFunction, BasicBlock* basic_block) : has_phi_nodes(false), blockTransferFunction(std::move(blockTransferFunction)), basic_block(basic_block) {};
+};
+
+// Direction policies of fixedPointSolver
+struct forwardDirection{
+  static constexpr bool is_forward = true;
+};
+
+struct backwardDirection{
+  static constexpr bool is_forward = false;
+};
+
+// Meet policy of fixedPointSolver: the in-place joinInto of the lattice type
+struct joinMeet{
+  template<typename T>
+  static bool join(T& dst, const T& src){
+    return joinInto(dst, src);
+  }
+};
+
+// Base for transfer policies of problems without phi edge transfers. A
+// transfer policy provides
+//   void block(unsigned idx, const T& in, T& out)
+//   bool has_edge_transfer(unsigned idx)
+//   void edge(unsigned idx, unsigned edge, const T& in, T& out)
+// where idx is a block number and edge applies the phi nodes of block idx
+// along one of its incoming edges, numbered as in cfgSnapshot.
+template<typename T>
+struct blockOnlyTransfer{
+  bool has_edge_transfer(unsigned idx) const{
+    return false;
+  }
+
+  void edge(unsigned idx, unsigned edge, const T& in, T& out) const{
+    llvm_unreachable("Problem has no phi edge transfers");
+  }
+};
+
+// State shared by every form of the solver: block numbering, boundary value,
+// strategy, scratch buffers and counters of the last run. Lattice values built
+// from arena (top, and the states and queries derived from it) must not
+// outlive the analysis object.
+template<typename T>
+class dataFlowBase{
+  public:
+    latticeArena arena; // Declared first so that it is destroyed last
+    T top;
+    solverStrategy strategy = WORKLIST;
+    unsigned threads = 0; // For COMPONENTS; 0 = all hardware threads
+    cfgSnapshot blocks;
+    T next_in, next_out; // Scratch results of one block evaluation
+    T edge_buffer; // Result of a phi edge transfer, reused across calls
+    solverCounters counters;
+
+    // Numbers the blocks of F; must be called before the transfer functions
+    // are constructed.
+    void number_blocks(Function &F){
+      blocks.init(F);
+    }
+
+    blockState<T> initial_state(const T& value){
+      return blockState<T>(&blocks, value);
+    }
 
-    transferFunction(bool is_forward, std::map<BasicBlock*, std::function<T(T)>> blockTransferFunction, BasicBlock* basic_block) : has_phi_nodes(false), is_forward(is_forward), blockTransferFunction(blockTransferFunction), basic_block(basic_block) {};
+    // How the blocks relate to their numbering before an edit
+    struct blockRemap{
+      enum : unsigned { new_block = ~0u };
+      std::vector<unsigned> old_index; // new_block for blocks added by the edit
+      std::vector<bool> preds_changed;
+      std::vector<bool> succs_changed;
+      cfgSnapshot old_blocks;
+    };
 
-    std::pair<T,T> forward_pass(std::map<std::pair<BasicBlock*,bool>, T>& current){
-      T meet_answer = top;
-      if(has_phi_nodes){
-        for(BasicBlock* pred : predecessors(basic_block)){
-          meet_answer = meet_answer^transferMap[pred](current[std::make_pair(pred, false)]);
+    // Renumbers the blocks of F after an edit and moves previous, the state
+    // before it, over to the new numbering. Added blocks start from initial.
+    // top must already cover values numbered since; every carried value is
+    // joined with it so that it does too. Returns the old numbering of each
+    // block, whether its edges changed and the old CFG. Blocks are matched by
+    // address, so an added block must be reported as edited even if it reuses
+    // the address of a deleted one.
+    blockRemap renumber_blocks(Function &F, blockState<T>& previous, const T& initial){
+      blockRemap remap;
+      cfgSnapshot& old_blocks = remap.old_blocks;
+      old_blocks = std::move(blocks);
+      blocks = cfgSnapshot();
+      blocks.init(F);
+      std::vector<blockValues<T>> values;
+      values.reserve(blocks.size());
+      for(unsigned idx = 0; idx < blocks.size(); idx++){
+        BasicBlock* bb = blocks.blocks[idx];
+        auto it = old_blocks.indices.find(bb);
+        if(it == old_blocks.indices.end()){
+          remap.old_index.push_back(blockRemap::new_block);
+          remap.preds_changed.push_back(true);
+          remap.succs_changed.push_back(true);
+          values.push_back(blockValues<T>{initial, initial});
+          continue;
         }
+        unsigned old_idx = it->second;
+        remap.old_index.push_back(old_idx);
+        remap.preds_changed.push_back(!same_blocks(blocks, blocks.pred_indices(idx), old_blocks, old_blocks.pred_indices(old_idx)));
+        remap.succs_changed.push_back(!same_blocks(blocks, blocks.succ_indices(idx), old_blocks, old_blocks.succ_indices(old_idx)));
+        values.push_back(std::move(previous.values[old_idx]));
       }
-      else{
-        for(BasicBlock* pred : predecessors(basic_block)){
-          meet_answer = meet_answer^current[std::make_pair(pred, false)];
+      for(blockValues<T>& value : values){
+        joinInto(value.in, top);
+        joinInto(value.out, top);
+      }
+      previous.numbering = &blocks;
+      previous.values = std::move(values);
+      return remap;
+    }
+
+    // Blocks an edit touched: those reported dirty, added blocks and blocks
+    // whose edges changed
+    std::vector<bool> edited_blocks(const blockRemap& remap, ArrayRef<BasicBlock*> dirty){
+      std::vector<bool> edited(blocks.size(), false);
+      for(unsigned idx = 0; idx < blocks.size(); idx++){
+        edited[idx] = remap.preds_changed[idx] || remap.succs_changed[idx];
+      }
+      for(BasicBlock* bb : dirty){
+        auto it = blocks.indices.find(bb);
+        if(it != blocks.indices.end()){
+          edited[it->second] = true;
         }
       }
-      return std::make_pair(meet_answer, blockTransferFunction(meet_answer));
+      return edited;
     }
 
-    std::pair<T,T> backward_pass(std::map<std::pair<BasicBlock*,bool>, T>& current){
-      T meet_answer = top;
-      for(BasicBlock* succ : successors(basic_block)){
-        if((*blockToTransferFunctionsMap)[succ].has_phi_nodes){
-          meet_answer = meet_answer ^ (*blockToTransferFunctionsMap)[succ].transferMap[basic_block](current[std::make_pair(succ,true)]);
+    // Blocks whose value can depend on those in seeds: the seeds and every
+    // block reachable from them in the direction of the analysis
+    std::vector<bool> influenced_blocks(const std::vector<bool>& seeds, bool forward) const{
+      std::vector<bool> influenced(seeds);
+      std::vector<unsigned> stack;
+      for(unsigned idx = 0; idx < seeds.size(); idx++){
+        if(seeds[idx]){
+          stack.push_back(idx);
         }
-        else{
-          meet_answer = meet_answer ^ current[std::make_pair(succ, true)];
+      }
+      while(!stack.empty()){
+        unsigned idx = stack.back();
+        stack.pop_back();
+        for(unsigned next : forward ? blocks.succ_indices(idx) : blocks.pred_indices(idx)){
+          if(!influenced[next]){
+            influenced[next] = true;
+            stack.push_back(next);
+          }
         }
       }
-      return std::make_pair(blockTransferFunction(meet_answer), meet_answer);
+      return influenced;
     }
 
-    std::pair<T,T> pass(std::map<std::pair<BasicBlock*,bool>, T>& current){
-      if(is_forward){
-        return forward_pass(current);
+    ~dataFlowBase(){
+      if(AreStatisticsEnabled()){
+        record_arena_statistics(arena);
       }
-      return backward_pass(current);
     }
-};
 
-template <typename T>
-class dataFlow{
-  public:
-    bool is_forward;
-    T top;
-    std::map<BasicBlock*,transferFunction<T>> allTransferFunctions;
-    void run_dataflow(Function &F, std::map<std::pair<BasicBlock*, bool>, T>& previous){
-      Function::BasicBlockListType& basicBlockList = F.getBasicBlockList();
-      bool modified = true;
-      int count = 0;
-      std::map<std::pair<BasicBlock*,bool>,T> next = previous;
-      while(modified){
-        errs() << "Pass number: " << count++ << "\n";
-        modified = false;
-        for(auto& bb: basicBlockList){
-          std::pair<T,T> after_pass = allTransferFunctions[&bb].pass(next);
-          std::pair<BasicBlock*, bool> bb_in = std::make_pair(&bb, true);
-          std::pair<BasicBlock*, bool> bb_out = std::make_pair(&bb, false);
-          next[bb_in] = after_pass.first;
-          next[bb_out] = after_pass.second;
-          if(!modified && (previous[bb_in] != next[bb_in] || previous[bb_out] != next[bb_out])){
-            modified = true;
-          }
+    static bool same_blocks(const cfgSnapshot& a, ArrayRef<unsigned> a_indices, const cfgSnapshot& b, ArrayRef<unsigned> b_indices){
+      if(a_indices.size() != b_indices.size()){
+        return false;
+      }
+      for(unsigned pos = 0; pos < a_indices.size(); pos++){
+        if(a.blocks[a_indices[pos]] != b.blocks[b_indices[pos]]){
+          return false;
         }
-        previous = next;
       }
+      return true;
+    }
+
+    void record_statistics(blockState<T>& fixed_point){
+      uint64_t size_sum = 0;
+      uint64_t max_size = 0;
+      for(blockValues<T>& values : fixed_point.values){
+        uint64_t in_size = lattice_size(values.in);
+        uint64_t out_size = lattice_size(values.out);
+        size_sum += in_size + out_size;
+        max_size = std::max(max_size, std::max(in_size, out_size));
+      }
+      record_solver_statistics(counters, size_sum, 2 * fixed_point.values.size(), max_size);
+    }
+};
+
+// The fixed-point iteration, with direction, meet and transfer resolved at
+// compile time so that the calls into the transfer policy can be inlined.
+template<typename T, typename Direction, typename Transfer, typename Meet = joinMeet>
+class fixedPointSolver{
+  public:
+    fixedPointSolver(dataFlowBase<T>& state, Transfer& transfer) : state(state), blocks(state.blocks), counters(state.counters), transfer(transfer), main{state.next_in, state.next_out, state.edge_buffer, state.counters} {}
+
+    // Iterates from previous, which must be below the fixed point. With
+    // seeds, the worklist starts from the seeded blocks only: every other
+    // block must already satisfy its equation.
+    void run(Function &F, blockState<T>& previous, const std::vector<bool>* seeds = nullptr){
+      phaseTimer timer("solve", "Solve to a fixed point");
+      counters = solverCounters();
+      if(state.strategy == ROUND_ROBIN){
+        run_round_robin(previous);
+      }
+      else if(state.strategy == COMPONENTS){
+        run_components(previous);
+      }
+      else{
+        run_worklist(previous, seeds);
+      }
+      if(AreStatisticsEnabled()){
+        state.record_statistics(previous);
+      }
+    }
+
+  private:
+    dataFlowBase<T>& state;
+    const cfgSnapshot& blocks;
+    solverCounters& counters;
+    Transfer& transfer;
+
+    // Scratch values and counters of one thread of the solver
+    struct workspace{
+      T& in;
+      T& out;
+      T& edge_buffer;
+      solverCounters& counters;
+    };
+    workspace main; // The state's own buffers, for the calling thread
+
+    // Computes IN and OUT of block idx from the current state into the
+    // scratch buffers
+    void evaluate(unsigned idx, blockState<T>& current, workspace& ws){
+      T& in = ws.in;
+      T& out = ws.out;
+      solverCounters& counters = ws.counters;
+      if(Direction::is_forward){
+        in = state.top;
+        unsigned first = blocks.pred_begin[idx];
+        unsigned last = blocks.pred_begin[idx + 1];
+        if(transfer.has_edge_transfer(idx)){
+          for(unsigned edge = first; edge < last; edge++){
+            transfer.edge(idx, edge, current.out(blocks.preds[edge]), ws.edge_buffer);
+            Meet::join(in, ws.edge_buffer);
+            counters.transfer_calls++;
+            counters.meets++;
+          }
+        }
+        else{
+          for(unsigned edge = first; edge < last; edge++){
+            Meet::join(in, current.out(blocks.preds[edge]));
+            counters.meets++;
+          }
+        }
+        transfer.block(idx, in, out);
+      }
+      else{
+        out = state.top;
+        for(unsigned pos = blocks.succ_begin[idx]; pos < blocks.succ_begin[idx + 1]; pos++){
+          unsigned succ_idx = blocks.succs[pos];
+          if(transfer.has_edge_transfer(succ_idx)){
+            transfer.edge(succ_idx, blocks.succ_edges[pos], current.in(succ_idx), ws.edge_buffer);
+            Meet::join(out, ws.edge_buffer);
+            counters.transfer_calls++;
+          }
+          else{
+            Meet::join(out, current.in(succ_idx));
+          }
+          counters.meets++;
+        }
+        transfer.block(idx, out, in);
+      }
+      counters.transfer_calls++;
+    }
+
+    // Joins the result of evaluating block idx into the state and reports
+    // whether IN (first) or OUT (second) changed. Transfer functions are
+    // monotone and the state only grows, so the join is the new value.
+    std::pair<bool,bool> update_block(unsigned idx, blockState<T>& current, workspace& ws){
+      evaluate(idx, current, ws);
+      ws.counters.block_evaluations++;
+      blockValues<T>& values = current.values[idx];
+      bool in_changed = Meet::join(values.in, ws.in);
+      bool out_changed = Meet::join(values.out, ws.out);
+      ws.counters.changes += in_changed + out_changed;
+      return std::make_pair(in_changed, out_changed);
+    }
+
+    void run_round_robin(blockState<T>& previous){
+      bool modified = true;
+      while(modified){
+        counters.iterations++;
+        modified = false;
+        for(unsigned idx = 0; idx < blocks.size(); idx++){
+          std::pair<bool,bool> changed = update_block(idx, previous, main);
+          if(changed.first || changed.second){
+            modified = true;
+          }
+        }
+      }
+    }
+
+    // Block numbers in reverse post-order for forward problems, post-order for
+    // backward ones. Blocks unreachable from the entry are appended in layout
+    // order so that they still receive a value. The depth-first search visits
+    // successors in order, as po_iterator does.
+    std::vector<unsigned> visit_order(){
+      std::vector<unsigned> order;
+      std::vector<bool> visited(blocks.size(), false);
+      if(blocks.size() != 0){
+        std::vector<std::pair<unsigned,unsigned>> stack; // Block, next outgoing edge
+        stack.emplace_back(0, blocks.succ_begin[0]);
+        visited[0] = true;
+        while(!stack.empty()){
+          std::pair<unsigned,unsigned>& top = stack.back();
+          if(top.second < blocks.succ_begin[top.first + 1]){
+            unsigned succ = blocks.succs[top.second++];
+            if(!visited[succ]){
+              visited[succ] = true;
+              stack.emplace_back(succ, blocks.succ_begin[succ]);
+            }
+          }
+          else{
+            order.push_back(top.first);
+            stack.pop_back();
+          }
+        }
+        std::reverse(order.begin(), order.end());
+      }
+      for(unsigned idx = 0; idx < blocks.size(); idx++){
+        if(!visited[idx]){
+          order.push_back(idx);
+        }
+      }
+      if(!Direction::is_forward){
+        std::reverse(order.begin(), order.end());
+      }
+      return order;
+    }
+
+    void run_worklist(blockState<T>& previous, const std::vector<bool>* seeds){
+      std::vector<unsigned> order = visit_order();
+      std::vector<unsigned> priority(blocks.size());
+      for(unsigned pos = 0; pos < order.size(); pos++){
+        priority[order[pos]] = pos;
+      }
+      // Lowest priority first, each block queued at most once at a time
+      std::priority_queue<unsigned, std::vector<unsigned>, std::greater<unsigned>> worklist;
+      std::vector<bool> queued(order.size(), false);
+      for(unsigned pos = 0; pos < order.size(); pos++){
+        if(!seeds || (*seeds)[order[pos]]){
+          queued[pos] = true;
+          worklist.push(pos);
+        }
+      }
+      auto enqueue = [&](unsigned block){
+        unsigned pos = priority[block];
+        if(!queued[pos]){
+          queued[pos] = true;
+          worklist.push(pos);
+        }
+      };
+      unsigned last_pos = order.size();
+      while(!worklist.empty()){
+        unsigned pos = worklist.top();
+        worklist.pop();
+        if(pos <= last_pos){
+          counters.iterations++; // Wrapped around to the start of the order
+        }
+        last_pos = pos;
+        queued[pos] = false;
+        unsigned idx = order[pos];
+        std::pair<bool,bool> changed = update_block(idx, previous, main);
+        if(Direction::is_forward && changed.second){
+          for(unsigned succ : blocks.succ_indices(idx)){
+            enqueue(succ);
+          }
+        }
+        if(!Direction::is_forward && changed.first){
+          for(unsigned pred : blocks.pred_indices(idx)){
+            enqueue(pred);
+          }
+        }
+      }
+    }
+
+    // Solves the strongly connected components of the CFG one at a time, in
+    // topological order for forward problems and in reverse for backward ones,
+    // each with a worklist of its own blocks in visit order. A component only
+    // reads the values of components solved before it, so once those are done
+    // it is independent of the others: for lattices that can be updated
+    // concurrently, ready components are dispatched to a thread pool. The
+    // transfer policy must then be safe to call for different blocks at once.
+    void run_components(blockState<T>& previous){
+      cfgComponents components;
+      components.init(blocks);
+      std::vector<unsigned> order = visit_order();
+      std::vector<unsigned> priority(blocks.size());
+      for(unsigned pos = 0; pos < order.size(); pos++){
+        priority[order[pos]] = pos;
+      }
+      unsigned count = components.size();
+      // Components each one is an input of, in solving direction
+      std::vector<std::vector<unsigned>> dependents(count);
+      std::vector<unsigned> inputs(count, 0);
+      for(unsigned idx = 0; idx < blocks.size(); idx++){
+        for(unsigned succ : blocks.succ_indices(idx)){
+          unsigned from = components.component[idx];
+          unsigned to = components.component[succ];
+          if(from == to){
+            continue;
+          }
+          if(!Direction::is_forward){
+            std::swap(from, to);
+          }
+          if(dependents[from].empty() || dependents[from].back() != to){
+            dependents[from].push_back(to);
+          }
+        }
+      }
+      for(std::vector<unsigned>& targets : dependents){
+        std::sort(targets.begin(), targets.end());
+        targets.erase(std::unique(targets.begin(), targets.end()), targets.end());
+        for(unsigned target : targets){
+          inputs[target]++;
+        }
+      }
+      unsigned pool_threads = hardware_concurrency(state.threads).compute_thread_count();
+      if(!concurrentLattice<T>::value || pool_threads <= 1 || count <= 1 || in_parallel_worker()){
+        for(unsigned pos = 0; pos < count; pos++){
+          unsigned component = Direction::is_forward ? pos : count - 1 - pos;
+          solve_component(components.blocks_of(component), components.cyclic[component], priority, previous, main);
+        }
+        return;
+      }
+      std::unique_ptr<std::atomic<unsigned>[]> pending(new std::atomic<unsigned>[count]);
+      for(unsigned component = 0; component < count; component++){
+        pending[component] = inputs[component];
+      }
+      std::mutex counters_mutex;
+      state.arena.set_shared(true);
+      {
+        ThreadPool pool(hardware_concurrency(state.threads));
+        // Solves component and then, on the same thread, one of the components
+        // it made ready; the others are queued
+        std::function<void(unsigned)> solve_from = [&](unsigned component){
+          T in = state.top, out = state.top, edge_buffer = state.top;
+          solverCounters local;
+          workspace ws{in, out, edge_buffer, local};
+          while(true){
+            solve_component(components.blocks_of(component), components.cyclic[component], priority, previous, ws);
+            unsigned next = count;
+            for(unsigned dependent : dependents[component]){
+              if(pending[dependent].fetch_sub(1) != 1){
+                continue;
+              }
+              if(next == count){
+                next = dependent;
+              }
+              else{
+                pool.async(solve_from, dependent);
+              }
+            }
+            if(next == count){
+              break;
+            }
+            component = next;
+          }
+          std::lock_guard<std::mutex> lock(counters_mutex);
+          counters += local;
+        };
+        for(unsigned component = 0; component < count; component++){
+          if(inputs[component] == 0){
+            pool.async(solve_from, component);
+          }
+        }
+        pool.wait();
+      }
+      state.arena.set_shared(false);
+    }
+
+    void solve_component(ArrayRef<unsigned> members, bool cyclic, const std::vector<unsigned>& priority, blockState<T>& previous, workspace& ws){
+      if(!cyclic){
+        ws.counters.iterations++;
+        update_block(members[0], previous, ws);
+        return;
+      }
+      // The members in visit order; the worklist holds positions in it,
+      // lowest first, each queued at most once at a time
+      std::vector<unsigned> local_order(members.begin(), members.end());
+      std::sort(local_order.begin(), local_order.end(), [&](unsigned a, unsigned b){
+        return priority[a] < priority[b];
+      });
+      DenseMap<unsigned, unsigned> local_position;
+      for(unsigned pos = 0; pos < local_order.size(); pos++){
+        local_position[local_order[pos]] = pos;
+      }
+      std::priority_queue<unsigned, std::vector<unsigned>, std::greater<unsigned>> worklist;
+      std::vector<bool> queued(local_order.size(), true);
+      for(unsigned pos = 0; pos < local_order.size(); pos++){
+        worklist.push(pos);
+      }
+      auto enqueue = [&](unsigned block){
+        auto it = local_position.find(block);
+        if(it != local_position.end() && !queued[it->second]){
+          queued[it->second] = true;
+          worklist.push(it->second);
+        }
+      };
+      unsigned last_pos = local_order.size();
+      while(!worklist.empty()){
+        unsigned pos = worklist.top();
+        worklist.pop();
+        if(pos <= last_pos){
+          ws.counters.iterations++; // Wrapped around to the start of the order
+        }
+        last_pos = pos;
+        queued[pos] = false;
+        unsigned idx = local_order[pos];
+        std::pair<bool,bool> changed = update_block(idx, previous, ws);
+        if(Direction::is_forward && changed.second){
+          for(unsigned succ : blocks.succ_indices(idx)){
+            enqueue(succ);
+          }
+        }
+        if(!Direction::is_forward && changed.first){
+          for(unsigned pred : blocks.pred_indices(idx)){
+            enqueue(pred);
+          }
+        }
+      }
+    }
+};
+
+// Dataflow problem fixed at compile time. Subclasses number the blocks, set
+// top (the boundary value every meet starts from) and fill in the transfer
+// policy.
+template<typename T, typename Direction, typename Transfer, typename Meet = joinMeet>
+class staticDataFlow : public dataFlowBase<T>{
+  public:
+    static constexpr bool is_forward = Direction::is_forward;
+    Transfer transfer;
+
+    void run_dataflow(Function &F, blockState<T>& previous, const std::vector<bool>* seeds = nullptr){
+      fixedPointSolver<T, Direction, Transfer, Meet>(*this, transfer).run(F, previous, seeds);
+    }
+
+    // Re-solves after an edit of F, given previous, the fixed point before it.
+    // dirty lists the blocks whose instructions changed, including added
+    // blocks; blocks whose edges changed are found by comparing the CFGs.
+    // Only the blocks an edited block can influence are reset to initial and
+    // solved again, the others keep their values. For transfer policies that
+    // read the instructions when applied, like mayPointTransfer; those
+    // holding per-block data must rebuild it for the edited blocks first.
+    void reanalyze(Function &F, blockState<T>& previous, ArrayRef<BasicBlock*> dirty, const T& initial){
+      typename dataFlowBase<T>::blockRemap remap = this->renumber_blocks(F, previous, initial);
+      std::vector<bool> influenced = this->influenced_blocks(this->edited_blocks(remap, dirty), is_forward);
+      for(unsigned idx = 0; idx < influenced.size(); idx++){
+        if(influenced[idx]){
+          previous.values[idx] = blockValues<T>{initial, initial};
+        }
+      }
+      run_dataflow(F, previous, &influenced);
+    }
+};
+
+// Transfer policy over the transferFunction objects of dataFlow
+template<typename T>
+struct runtimeTransfer{
+  std::vector<transferFunction<T>>& functions;
+  const cfgSnapshot& cfg;
+
+  bool has_edge_transfer(unsigned idx) const{
+    return functions[idx].has_phi_nodes;
+  }
+
+  void edge(unsigned idx, unsigned edge, const T& in, T& out) const{
+    functions[idx].transferMap[cfg.blocks[cfg.preds[edge]]](in, out);
+  }
+
+  void block(unsigned idx, const T& in, T& out) const{
+    functions[idx].blockTransferFunction(in, out);
+  }
+};
+
+// Dataflow problem configured at run time with std::function transfers and a
+// direction flag. It dispatches to the same solver as staticDataFlow.
+template <typename T>
+class dataFlow : public dataFlowBase<T>{
+  public:
+    bool is_forward;
+    std::vector<transferFunction<T>> allTransferFunctions; // Indexed by block number
+
+    void number_blocks(Function &F){
+      this->blocks.init(F);
+      allTransferFunctions.assign(this->blocks.size(), transferFunction<T>());
+    }
+
+    void run_dataflow(Function &F, blockState<T>& previous, const std::vector<bool>* seeds = nullptr){
+      runtimeTransfer<T> transfer{allTransferFunctions, this->blocks};
+      if(is_forward){
+        fixedPointSolver<T, forwardDirection, runtimeTransfer<T>>(*this, transfer).run(F, previous, seeds);
+      }
+      else{
+        fixedPointSolver<T, backwardDirection, runtimeTransfer<T>>(*this, transfer).run(F, previous, seeds);
+      }
+    }
+
+    // Re-solves after an edit of F, as staticDataFlow::reanalyze does. The
+    // transfer functions of unedited blocks are kept; rebuild constructs
+    // those of the edited ones.
+    void reanalyze(Function &F, blockState<T>& previous, ArrayRef<BasicBlock*> dirty, const T& initial, std::function<transferFunction<T>(BasicBlock*)> rebuild){
+      std::vector<transferFunction<T>> old_functions = std::move(allTransferFunctions);
+      typename dataFlowBase<T>::blockRemap remap = this->renumber_blocks(F, previous, initial);
+      std::vector<bool> edited = this->edited_blocks(remap, dirty);
+      allTransferFunctions.clear();
+      for(unsigned idx = 0; idx < this->blocks.size(); idx++){
+        if(edited[idx]){
+          allTransferFunctions.push_back(rebuild(this->blocks.blocks[idx]));
+        }
+        else{
+          allTransferFunctions.push_back(std::move(old_functions[remap.old_index[idx]]));
+        }
+      }
+      std::vector<bool> influenced = this->influenced_blocks(edited, is_forward);
+      for(unsigned idx = 0; idx < influenced.size(); idx++){
+        if(influenced[idx]){
+          previous.values[idx] = blockValues<T>{initial, initial};
+        }
+      }
+      run_dataflow(F, previous, &influenced);
+    }
+};
+
+// Transfer policy of bit-vector problems: each block, and each phi edge that
+// needs its own transfer, is summarized once as gen/kill sets, so a solver
+// step costs a few word-wise operations instead of a walk over the block.
+template<typename T, typename V>
+struct genKillTransfer{
+  std::vector<genKillSummary<T,V>> blockSummaries; // Indexed by block number
+  std::vector<genKillSummary<T,V>> edgeSummaries; // Indexed by edge number
+  std::vector<bool> hasEdgeSummaries; // Indexed by block number
+
+  bool has_edge_transfer(unsigned idx) const{
+    return hasEdgeSummaries[idx];
+  }
+
+  void edge(unsigned idx, unsigned edge, const T& in, T& out) const{
+    edgeSummaries[edge].apply(in, out);
+  }
+
+  void block(unsigned idx, const T& in, T& out) const{
+    blockSummaries[idx].apply(in, out);
+  }
+};
+
+// staticDataFlow for bit-vector problems. Subclasses fill
+// transfer.blockSummaries, and for blocks whose phi nodes need a separate
+// transfer on each incoming edge, transfer.edgeSummaries of those edges and
+// transfer.hasEdgeSummaries.
+template<typename T, typename V, typename Direction>
+class genKillDataFlow : public staticDataFlow<T, Direction, genKillTransfer<T,V>>{
+  public:
+    // Must be called after number_blocks and after top is set
+    void init_summaries(){
+      this->transfer.blockSummaries.assign(this->blocks.size(), genKillSummary<T,V>(this->top));
+      this->transfer.edgeSummaries.assign(this->blocks.edge_count(), genKillSummary<T,V>(this->top));
+      this->transfer.hasEdgeSummaries.assign(this->blocks.size(), false);
+    }
+
+    // Re-solves after an edit of F, given previous, the fixed point before it,
+    // and the numbers of values that no longer exist. dirty lists the blocks
+    // whose instructions changed, including added blocks; summarize(idx)
+    // rebuilds the summaries of one block and is called for those and for
+    // blocks whose edges changed. top must already cover the current values.
+    //
+    // Each element is solved independently in a gen/kill problem, and its
+    // solution can only shrink where an edited block stopped generating it,
+    // started killing it or lost an edge it arrived along. Only those
+    // elements are cleared, only in the blocks holding them downstream of an
+    // edit, and the worklist starts from the edited and cleared blocks, so the
+    // work follows the extent of the edit rather than the size of F.
+    template<typename Summarize>
+    void reanalyze(Function &F, blockState<T>& previous, ArrayRef<BasicBlock*> dirty, ArrayRef<unsigned> retired, Summarize summarize){
+      const bool forward = Direction::is_forward;
+      genKillTransfer<T,V> old_transfer = std::move(this->transfer);
+      typename dataFlowBase<T>::blockRemap remap = this->renumber_blocks(F, previous, this->top);
+      const cfgSnapshot& old_blocks = remap.old_blocks;
+      std::vector<bool> edited = this->edited_blocks(remap, dirty);
+      init_summaries();
+      T shrinking = this->top; // Elements whose solution may shrink
+      for(unsigned number : retired){
+        shrinking.test_and_set(number);
+      }
+      for(unsigned idx = 0; idx < this->blocks.size(); idx++){
+        unsigned old_idx = remap.old_index[idx];
+        if(!edited[idx]){
+          std::swap(this->transfer.blockSummaries[idx], old_transfer.blockSummaries[old_idx]);
+          widen(this->transfer.blockSummaries[idx]);
+          if(old_transfer.hasEdgeSummaries[old_idx]){
+            unsigned old_edge = old_blocks.pred_begin[old_idx];
+            for(unsigned edge = this->blocks.pred_begin[idx]; edge < this->blocks.pred_begin[idx + 1]; edge++, old_edge++){
+              std::swap(this->transfer.edgeSummaries[edge], old_transfer.edgeSummaries[old_edge]);
+              widen(this->transfer.edgeSummaries[edge]);
+            }
+            this->transfer.hasEdgeSummaries[idx] = true;
+          }
+          continue;
+        }
+        summarize(idx);
+        if(forward ? remap.preds_changed[idx] : remap.succs_changed[idx]){
+          shrinking.unite(forward ? previous.in(idx) : previous.out(idx));
+        }
+        const genKillSummary<T,V>& summary = this->transfer.blockSummaries[idx];
+        if(old_idx == dataFlowBase<T>::blockRemap::new_block){
+          shrinking.unite(summary.kill);
+          continue;
+        }
+        const genKillSummary<T,V>& old_summary = old_transfer.blockSummaries[old_idx];
+        T difference = old_summary.gen;
+        difference.subtract(summary.gen);
+        shrinking.unite(difference);
+        difference = summary.kill;
+        difference.subtract(old_summary.kill);
+        shrinking.unite(difference);
+        for(unsigned edge = this->blocks.pred_begin[idx]; edge < this->blocks.pred_begin[idx + 1]; edge++){
+          shrinking.unite(this->transfer.edgeSummaries[edge].kill);
+        }
+        if(old_transfer.hasEdgeSummaries[old_idx]){
+          for(unsigned edge = old_blocks.pred_begin[old_idx]; edge < old_blocks.pred_begin[old_idx + 1]; edge++){
+            shrinking.unite(old_transfer.edgeSummaries[edge].gen);
+          }
+        }
+      }
+      // Clears the shrinking elements downstream of the edited blocks,
+      // following only blocks that held some of them
+      std::vector<bool> seeds(edited);
+      std::vector<bool> visited(edited);
+      std::vector<unsigned> stack;
+      for(unsigned idx = 0; idx < edited.size(); idx++){
+        if(edited[idx]){
+          stack.push_back(idx);
+        }
+      }
+      while(!stack.empty()){
+        unsigned idx = stack.back();
+        stack.pop_back();
+        bool cleared = previous.in(idx).erase_all(shrinking);
+        cleared |= previous.out(idx).erase_all(shrinking);
+        if(!cleared){
+          continue;
+        }
+        seeds[idx] = true;
+        for(unsigned next : forward ? this->blocks.succ_indices(idx) : this->blocks.pred_indices(idx)){
+          if(!visited[next]){
+            visited[next] = true;
+            stack.push_back(next);
+          }
+        }
+      }
+      this->run_dataflow(F, previous, &seeds);
+    }
+
+  private:
+    void widen(genKillSummary<T,V>& summary){
+      joinInto(summary.gen, this->top);
+      joinInto(summary.kill, this->top);
+    }
+};
+
+// Per-instruction results computed on demand from the block-boundary fixed
+// point, instead of a lattice copy stored for every instruction. A pass gives
+// the effect of one instruction on the value, and whether the value reported
+// at an instruction is taken before or after that effect. valueAt replays the
+// block from its boundary (IN for forward problems, OUT for backward ones) and
+// keeps the results of the most recently replayed blocks in a bounded cache.
+template<typename T>
+class instructionQuery{
+  public:
+    typedef std::function<void(Instruction*, T&)> instructionTransferType;
+
+    blockState<T> fixed_point;
+    bool is_forward;
+    bool record_after; // Report the value after the instruction's effect
+    instructionTransferType transfer;
+    std::function<bool(Instruction*)> has_value; // Instructions with a result; all if empty
+
+    // The cache keeps at least the block of the last query, whose values
+    // valueAt returns by reference
+    instructionQuery(blockState<T> fixed_point, bool is_forward, bool record_after, instructionTransferType transfer, unsigned cache_blocks = 16) : fixed_point(std::move(fixed_point)), is_forward(is_forward), record_after(record_after), transfer(std::move(transfer)), cache_blocks(std::max(cache_blocks, 1u)) {}
+
+    bool reports(Instruction* inst) const{
+      return !has_value || has_value(inst);
+    }
+
+    // The value at inst. The reference stays valid until the next call.
+    const T& valueAt(Instruction* inst){
+      cacheEntry& entry = replay(fixed_point.numbering->index(inst->getParent()));
+      return entry.values[entry.positions[inst]];
+    }
+
+    // Walks one block in the direction of the analysis, keeping only the
+    // current value:
+    //   for(auto it = query.walk(bb); !it.done(); it.advance())
+    //     use(it.instruction(), it.value());
+    class blockWalker{
+      public:
+        blockWalker(instructionQuery& query, BasicBlock* bb) : query(query), bb(bb) {
+          unsigned idx = query.fixed_point.numbering->index(bb);
+          current = query.is_forward ? query.fixed_point.in(idx) : query.fixed_point.out(idx);
+          if(query.is_forward){
+            position = bb->begin();
+          }
+          else{
+            position = bb->end();
+            if(position != bb->begin()){
+              --position;
+            }
+          }
+          finished = bb->empty();
+          if(!finished){
+            visit();
+          }
+        }
+
+        bool done() const{
+          return finished;
+        }
+
+        Instruction* instruction() const{
+          return &*position;
+        }
+
+        const T& value() const{
+          return query.record_after ? current : before;
+        }
+
+        void advance(){
+          if(query.is_forward){
+            ++position;
+            finished = position == bb->end();
+          }
+          else{
+            finished = position == bb->begin();
+            if(!finished){
+              --position;
+            }
+          }
+          if(!finished){
+            visit();
+          }
+        }
+
+      private:
+        instructionQuery& query;
+        BasicBlock* bb;
+        BasicBlock::iterator position;
+        bool finished;
+        T current;
+        T before;
+
+        void visit(){
+          if(!query.record_after){
+            before = current;
+          }
+          query.transfer(&*position, current);
+        }
+    };
+
+    blockWalker walk(BasicBlock* bb){
+      return blockWalker(*this, bb);
+    }
+
+  private:
+    // Values of every instruction of one block, in program order
+    struct cacheEntry{
+      unsigned block;
+      DenseMap<Instruction*, unsigned> positions;
+      std::vector<T> values;
+    };
+    unsigned cache_blocks;
+    std::list<cacheEntry> cache; // Most recently used first
+
+    cacheEntry& replay(unsigned idx){
+      for(auto it = cache.begin(); it != cache.end(); ++it){
+        if(it->block == idx){
+          cache.splice(cache.begin(), cache, it);
+          return cache.front();
+        }
+      }
+      phaseTimer timer("propagate", "Propagate to instructions");
+      if(cache.size() >= cache_blocks){
+        cache.pop_back();
+      }
+      cache.push_front(cacheEntry());
+      cacheEntry& entry = cache.front();
+      entry.block = idx;
+      BasicBlock* bb = fixed_point.numbering->blocks[idx];
+      unsigned size = bb->size();
+      entry.values.resize(size);
+      unsigned position = is_forward ? 0 : size - 1;
+      for(blockWalker it(*this, bb); !it.done(); it.advance()){
+        entry.values[position] = it.value();
+        entry.positions[it.instruction()] = position;
+        position = is_forward ? position + 1 : position - 1;
+      }
+      return entry;
     }
 };
+
+// Runs analyze on every function of M that has a body, concurrently on a pool
+// of threads (0 = all hardware threads). Each function writes to its own
+// buffer; the buffers are emitted to OS in module order once all are done.
+// The largest functions are submitted first so that they do not end up as the
+// tail of the run.
+inline void run_on_functions_in_parallel(Module &M, unsigned threads, std::function<void(Function&, raw_ostream&)> analyze, raw_ostream &OS){
+  std::vector<Function*> functions;
+  for(auto& F : M){
+    if(!F.isDeclaration()){
+      functions.push_back(&F);
+    }
+  }
+  std::vector<unsigned> schedule(functions.size());
+  std::vector<unsigned> sizes(functions.size());
+  for(unsigned idx = 0; idx < functions.size(); idx++){
+    schedule[idx] = idx;
+    sizes[idx] = functions[idx]->getInstructionCount();
+  }
+  std::stable_sort(schedule.begin(), schedule.end(), [&sizes](unsigned a, unsigned b){
+    return sizes[a] > sizes[b];
+  });
+  std::vector<std::string> outputs(functions.size());
+  {
+    ThreadPool pool(hardware_concurrency(threads));
+    for(unsigned idx : schedule){
+      pool.async([&analyze, &functions, &outputs, idx](){
+        raw_string_ostream buffer(outputs[idx]);
+        in_parallel_worker() = true;
+        analyze(*functions[idx], buffer);
+        buffer.flush();
+      });
+    }
+    pool.wait();
+  }
+  for(const std::string& output : outputs){
+    OS << output;
+  }
+}
+
+// Writes the results of one function. Operands are printed through a single
+// ModuleSlotTracker for the function; without one every printAsOperand call
+// renumbers the whole function. Output is collected in a buffer and handed to
+// the destination stream in large chunks.
+class resultEmitter{
+  public:
+    outputMode mode;
+
+    resultEmitter(Function &F, raw_ostream &OS, outputMode mode) : mode(mode), function(F), destination(OS), stream(buffer), slots(F.getParent()) {
+      slots.incorporateFunction(F);
+    }
+
+    ~resultEmitter(){
+      flush();
+    }
+
+    raw_ostream& out(){
+      return stream;
+    }
+
+    void flush(){
+      destination << buffer;
+      buffer.clear();
+    }
+
+    // Flushes once enough output has accumulated; called between records
+    void end_record(){
+      if(buffer.size() >= flush_threshold){
+        flush();
+      }
+    }
+
+    void operand(const Value* v, bool print_type = true){
+      v->printAsOperand(stream, print_type, slots);
+    }
+
+    std::string operand_name(const Value* v){
+      std::string name;
+      raw_string_ostream name_stream(name);
+      v->printAsOperand(name_stream, false, slots);
+      return name_stream.str();
+    }
+
+    void instruction(const Instruction& inst){
+      inst.print(stream, slots);
+    }
+
+    // Prints "{v1, v2, }" followed by a newline
+    template<typename Set>
+    void value_set(const Set& values, bool print_type = true){
+      stream << "{";
+      for(auto v : values){
+        operand(v, print_type);
+        stream << ", ";
+      }
+      stream << "}\n";
+    }
+
+    // Writes {"function": ..., "block": ..., "instruction": index, <fields>}
+    // on one line; index is the position of the instruction in its block.
+    void json_record(BasicBlock* bb, unsigned index, function_ref<void(json::OStream&)> fields){
+      json::OStream record(stream);
+      record.object([&](){
+        record.attribute("function", function.getName());
+        record.attribute("block", operand_name(bb));
+        record.attribute("instruction", (int64_t)index);
+        fields(record);
+      });
+      stream << "\n";
+      end_record();
+    }
+
+    // Writes {"function": ..., <fields>} on one line, for results that hold
+    // for the whole function
+    void json_record(function_ref<void(json::OStream&)> fields){
+      json::OStream record(stream);
+      record.object([&](){
+        record.attribute("function", function.getName());
+        fields(record);
+      });
+      stream << "\n";
+      end_record();
+    }
+
+    template<typename Set>
+    void json_value_set(json::OStream& record, StringRef key, const Set& values){
+      record.attributeArray(key, [&](){
+        for(auto v : values){
+          record.value(operand_name(v));
+        }
+      });
+    }
+
+  private:
+    static const unsigned flush_threshold = 1 << 16;
+    Function& function;
+    raw_ostream& destination;
+    SmallString<4096> buffer;
+    raw_svector_ostream stream;
+    ModuleSlotTracker slots;
+};
+
+// Printers used by the emitter for bit-vector lattices. Passes with other
+// lattice types provide overloads found by ADL.
+template<typename V>
+void print_lattice(resultEmitter& emitter, const bitVectorSet<V>& value){
+  emitter.value_set(value);
+}
+
+template<typename V>
+void json_lattice(resultEmitter& emitter, json::OStream& record, const bitVectorSet<V>& value){
+  emitter.json_value_set(record, "values", value);
+}
+
+// Prints the IN and OUT of every block, for SUMMARY_OUTPUT
+template<typename T>
+void emit_block_summaries(resultEmitter& emitter, Function& F, blockState<T>& fixed_point){
+  for(auto&& bb : F.getBasicBlockList()){
+    emitter.operand(&bb);
+    emitter.out() << ":\nIN: ";
+    print_lattice(emitter, fixed_point.in(&bb));
+    emitter.out() << "OUT: ";
+    print_lattice(emitter, fixed_point.out(&bb));
+    emitter.out() << "\n";
+    emitter.end_record();
+  }
+}
+
+// Writes one JSON line per instruction that has a result, for JSON_OUTPUT
+template<typename T>
+void emit_json(resultEmitter& emitter, Function& F, instructionQuery<T>& query){
+  for(auto&& bb : F.getBasicBlockList()){
+    unsigned index = 0;
+    for(auto inst = bb.begin(); inst != bb.end(); ++inst, ++index){
+      if(!query.reports(&*inst)){
+        continue;
+      }
+      const T& value = query.valueAt(&*inst);
+      emitter.json_record(&bb, index, [&](json::OStream& record){
+        json_lattice(emitter, record, value);
+      });
+    }
+  }
+}
+
+// Structural identity of a function for the result cache. The key is a hash
+// of everything the analyses read: the argument and result types, the
+// opcodes, and which value every operand is. Arguments and instructions are
+// coded by their position (arguments first, then instructions in layout
+// order); any other operand, a global or a constant, by the position of its
+// first use. Results stored under the key are decoded against the function at
+// hand, so a hit maps each code back to the value in that position.
+class functionFingerprint{
+  public:
+    std::string key;
+    std::vector<Value*> values; // By code
+
+    functionFingerprint(Function &F, StringRef analysis){
+      MD5 hash;
+      hash.update(analysis);
+      hash.update(StringRef("\0v1", 3));
+      DenseMap<BasicBlock*, unsigned> block_indices;
+      for(auto arg = F.arg_begin(); arg != F.arg_end(); ++arg){
+        add((Value*)&*arg);
+      }
+      for(auto&& bb : F.getBasicBlockList()){
+        block_indices[&bb] = block_indices.size();
+        for(auto&& inst : bb){
+          add((Value*)&inst);
+        }
+      }
+      hash_number(hash, F.arg_size());
+      for(auto arg = F.arg_begin(); arg != F.arg_end(); ++arg){
+        hash_type(hash, arg->getType());
+      }
+      unsigned position = 0; // Operand slots seen so far
+      for(auto&& bb : F.getBasicBlockList()){
+        hash_number(hash, bb.size());
+        for(auto&& inst : bb){
+          hash_number(hash, inst.getOpcode());
+          hash_type(hash, inst.getType());
+          hash_number(hash, inst.getNumOperands());
+          for(const Use& u : inst.operands()){
+            Value* v = u.get();
+            if(BasicBlock* target = dyn_cast<BasicBlock>(v)){
+              hash_number(hash, 0);
+              hash_number(hash, block_indices.lookup(target));
+            }
+            else{
+              auto inserted = codes.insert(std::make_pair(v, (unsigned)values.size()));
+              if(inserted.second){
+                values.push_back(v);
+                hash_number(hash, 1);
+                hash_number(hash, position);
+                hash_number(hash, v->getValueID());
+                hash_type(hash, v->getType());
+              }
+              else{
+                hash_number(hash, 2);
+                hash_number(hash, inserted.first->second);
+              }
+            }
+            position++;
+          }
+          if(PHINode* phi = dyn_cast<PHINode>(&inst)){
+            for(BasicBlock* incoming : phi->blocks()){
+              hash_number(hash, block_indices.lookup(incoming));
+            }
+          }
+        }
+      }
+      MD5::MD5Result digest;
+      hash.final(digest);
+      key = (analysis + "-" + digest.digest()).str();
+    }
+
+    // Code of v, or false if v is not used by the function
+    bool code(Value* v, unsigned& result) const{
+      auto it = codes.find(v);
+      if(it == codes.end()){
+        return false;
+      }
+      result = it->second;
+      return true;
+    }
+
+  private:
+    DenseMap<Value*, unsigned> codes;
+    DenseMap<Type*, std::string> type_names;
+
+    void add(Value* v){
+      codes[v] = values.size();
+      values.push_back(v);
+    }
+
+    static void hash_number(MD5& hash, uint64_t number){
+      uint8_t bytes[10];
+      hash.update(makeArrayRef(bytes, encodeULEB128(number, bytes)));
+    }
+
+    void hash_type(MD5& hash, Type* type){
+      std::string& name = type_names[type];
+      if(name.empty()){
+        raw_string_ostream stream(name);
+        type->print(stream);
+        stream.flush();
+      }
+      hash_number(hash, name.size());
+      hash.update(name);
+    }
+};
+
+// Compact binary form of cached results: unsigned LEB128 numbers
+class cacheWriter{
+  public:
+    std::string bytes;
+
+    void write(uint64_t number){
+      raw_string_ostream stream(bytes);
+      encodeULEB128(number, stream);
+    }
+
+    // Objects written more than once, such as interned sets, are written in
+    // full the first time and as a back reference after that. Writes the
+    // reference and returns true if object was written before; otherwise
+    // writes a marker and returns false, and the caller writes the object.
+    bool write_reference(const void* object){
+      auto inserted = references.insert(std::make_pair(object, (unsigned)references.size() + 1));
+      write(inserted.second ? 0 : inserted.first->second);
+      return !inserted.second;
+    }
+
+    // Names, for values outside the function a payload is keyed by
+    void write_string(StringRef text){
+      write(text.size());
+      bytes.append(text.begin(), text.end());
+    }
+
+    // A set of codes as its size and the sorted deltas between them
+    void write_codes(SmallVectorImpl<unsigned>& codes){
+      llvm::sort(codes);
+      write(codes.size());
+      unsigned last = 0;
+      for(unsigned code : codes){
+        write(code - last);
+        last = code;
+      }
+    }
+
+  private:
+    DenseMap<const void*, unsigned> references;
+};
+
+class cacheReader{
+  public:
+    explicit cacheReader(StringRef bytes) : position((const uint8_t*)bytes.begin()), end((const uint8_t*)bytes.end()) {}
+
+    // Returns 0 and sets failed once the data is exhausted or malformed
+    uint64_t read(){
+      if(failed){
+        return 0;
+      }
+      const char* error = nullptr;
+      unsigned length = 0;
+      uint64_t number = decodeULEB128(position, &length, end, &error);
+      if(error){
+        failed = true;
+        return 0;
+      }
+      position += length;
+      return number;
+    }
+
+    StringRef read_string(){
+      uint64_t size = read();
+      if(failed || size > (uint64_t)(end - position)){
+        failed = true;
+        return StringRef();
+      }
+      StringRef text((const char*)position, size);
+      position += size;
+      return text;
+    }
+
+    // Reads a set written by write_codes, checking each code against limit
+    bool read_codes(SmallVectorImpl<unsigned>& codes, unsigned limit){
+      codes.clear();
+      uint64_t count = read();
+      if(count > limit){
+        failed = true;
+      }
+      unsigned code = 0;
+      for(uint64_t pos = 0; pos < count && !failed; pos++){
+        code += read();
+        if(code >= limit){
+          failed = true;
+        }
+        codes.push_back(code);
+      }
+      return !failed;
+    }
+
+    // Reads what write_reference wrote: the object referred to, or nullptr
+    // if the object follows, in which case the caller reads it and passes
+    // the result to add_reference
+    const void* read_reference(){
+      uint64_t id = read();
+      if(id > objects.size()){
+        failed = true;
+      }
+      return id == 0 || failed ? nullptr : objects[id - 1];
+    }
+
+    void add_reference(const void* object){
+      objects.push_back(object);
+    }
+
+    bool at_end() const{
+      return position == end;
+    }
+
+    bool failed = false;
+
+  private:
+    std::vector<const void*> objects;
+    const uint8_t* position;
+    const uint8_t* end;
+};
+
+// Cache codecs for bit-vector lattices. Passes with other lattice types
+// provide overloads found by ADL; encoding fails for values the fingerprint
+// has no code for.
+template<typename V>
+bool encode_lattice(cacheWriter& writer, const functionFingerprint& fingerprint, const bitVectorSet<V>& value){
+  SmallVector<unsigned, 32> codes;
+  for(unsigned bit = value.find_next(0); bit < value.words.size() * bitVectorSet<V>::word_bits; bit = value.find_next(bit + 1)){
+    unsigned code;
+    if(!fingerprint.code(value.numbering->values[bit], code)){
+      return false;
+    }
+    codes.push_back(code);
+  }
+  writer.write_codes(codes);
+  return true;
+}
+
+// Adds the decoded elements to value, which must be empty
+template<typename V>
+bool decode_lattice(cacheReader& reader, const functionFingerprint& fingerprint, bitVectorSet<V>& value){
+  SmallVector<unsigned, 32> codes;
+  if(!reader.read_codes(codes, fingerprint.values.size())){
+    return false;
+  }
+  for(unsigned code : codes){
+    auto it = value.numbering->indices.find(fingerprint.values[code]);
+    if(it == value.numbering->indices.end()){
+      return false;
+    }
+    value.test_and_set(it->second);
+  }
+  return true;
+}
+
+// Block fixed points on disk, one file per function key, in a directory
+// shared by the passes and across runs. Files are written to a temporary name
+// and renamed, so concurrent writers never expose partial entries. A hit
+// refreshes the file's modification time; once the files exceed max_bytes the
+// least recently used ones are removed. Safe to use from parallel workers.
+class resultCache{
+  public:
+    std::atomic<unsigned long> hits{0};
+    std::atomic<unsigned long> misses{0};
+    std::atomic<unsigned long> stores{0};
+    std::atomic<unsigned long> evictions{0};
+
+    resultCache(StringRef directory, uint64_t max_bytes) : directory(directory.str()), max_bytes(max_bytes) {
+      sys::fs::create_directories(directory);
+      std::vector<entry> entries;
+      total_bytes = scan(entries);
+    }
+
+    // The payload stored under key, or false on a miss
+    bool lookup(StringRef key, std::string& payload){
+      static Statistic NumCacheHits = {"dataflow", "NumCacheHits", "Functions whose fixed point was found in the result cache"};
+      static Statistic NumCacheMisses = {"dataflow", "NumCacheMisses", "Functions missing from the result cache"};
+      int fd;
+      if(sys::fs::openFileForRead(path(key), fd)){
+        misses++;
+        NumCacheMisses++;
+        return false;
+      }
+      ErrorOr<std::unique_ptr<MemoryBuffer>> buffer = MemoryBuffer::getOpenFile(sys::fs::convertFDToNativeFile(fd), path(key), -1, false);
+      if(buffer){
+        sys::fs::setLastAccessAndModificationTime(fd, std::chrono::system_clock::now());
+      }
+      sys::Process::SafelyCloseFileDescriptor(fd);
+      if(!buffer || !(*buffer)->getBuffer().startswith(magic())){
+        misses++;
+        NumCacheMisses++;
+        return false;
+      }
+      payload = (*buffer)->getBuffer().drop_front(magic().size()).str();
+      hits++;
+      NumCacheHits++;
+      return true;
+    }
+
+    void store(StringRef key, StringRef payload){
+      static Statistic NumCacheStores = {"dataflow", "NumCacheStores", "Fixed points written to the result cache"};
+      SmallString<128> temporary;
+      int fd;
+      if(sys::fs::createUniqueFile(directory + "/tmp-%%%%%%%%", fd, temporary)){
+        return;
+      }
+      {
+        raw_fd_ostream out(fd, true);
+        out << magic() << payload;
+        if(out.has_error()){
+          out.clear_error();
+          sys::fs::remove(temporary);
+          return;
+        }
+      }
+      if(sys::fs::rename(temporary, path(key))){
+        sys::fs::remove(temporary);
+        return;
+      }
+      stores++;
+      NumCacheStores++;
+      if((total_bytes += magic().size() + payload.size()) > max_bytes){
+        prune();
+      }
+    }
+
+    // Removes the least recently used entries until the cache is back under
+    // three quarters of max_bytes
+    void prune(){
+      static Statistic NumCacheEvictions = {"dataflow", "NumCacheEvictions", "Entries evicted from the result cache"};
+      std::lock_guard<std::mutex> lock(prune_mutex);
+      std::vector<entry> entries;
+      uint64_t size = scan(entries);
+      if(size <= max_bytes){
+        total_bytes = size;
+        return;
+      }
+      std::sort(entries.begin(), entries.end(), [](const entry& a, const entry& b){
+        return a.used < b.used;
+      });
+      for(const entry& old : entries){
+        if(size <= max_bytes / 4 * 3){
+          break;
+        }
+        if(!sys::fs::remove(old.path)){
+          size -= old.size;
+          evictions++;
+          NumCacheEvictions++;
+        }
+      }
+      total_bytes = size;
+    }
+
+  private:
+    struct entry{
+      std::string path;
+      uint64_t size;
+      sys::TimePoint<> used;
+    };
+
+    std::string directory;
+    uint64_t max_bytes;
+    std::atomic<uint64_t> total_bytes;
+    std::mutex prune_mutex;
+
+    static StringRef magic(){
+      return StringRef("DFC\x01", 4);
+    }
+
+    std::string path(StringRef key) const{
+      return (directory + "/" + key).str();
+    }
+
+    // Lists the entries, returning their total size
+    uint64_t scan(std::vector<entry>& entries){
+      uint64_t size = 0;
+      std::error_code error;
+      for(sys::fs::directory_iterator it(directory, error), end; it != end && !error; it.increment(error)){
+        if(sys::path::filename(it->path()).startswith("tmp-")){
+          continue;
+        }
+        ErrorOr<sys::fs::basic_file_status> status = it->status();
+        if(!status || status->type() != sys::fs::file_type::regular_file){
+          continue;
+        }
+        entries.push_back(entry{it->path(), status->getSize(), status->getLastModificationTime()});
+        size += status->getSize();
+      }
+      return size;
+    }
+};
+
+// Fills previous, which must be initial_state of an empty lattice value, with
+// the fixed point cached for the function of fingerprint
+template<typename T>
+bool load_cached_fixed_point(resultCache& cache, const functionFingerprint& fingerprint, blockState<T>& previous){
+  std::string payload;
+  if(!cache.lookup(fingerprint.key, payload)){
+    return false;
+  }
+  cacheReader reader(payload);
+  if(reader.read() != previous.values.size() || reader.read() != fingerprint.values.size()){
+    return false;
+  }
+  blockState<T> loaded = previous;
+  for(blockValues<T>& value : loaded.values){
+    if(!decode_lattice(reader, fingerprint, value.in) || !decode_lattice(reader, fingerprint, value.out)){
+      return false;
+    }
+  }
+  if(!reader.at_end()){
+    return false;
+  }
+  previous = std::move(loaded);
+  return true;
+}
+
+template<typename T>
+void store_cached_fixed_point(resultCache& cache, const functionFingerprint& fingerprint, blockState<T>& previous){
+  cacheWriter writer;
+  writer.write(previous.values.size());
+  writer.write(fingerprint.values.size());
+  for(blockValues<T>& value : previous.values){
+    if(!encode_lattice(writer, fingerprint, value.in) || !encode_lattice(writer, fingerprint, value.out)){
+      return;
+    }
+  }
+  cache.store(fingerprint.key, writer.bytes);
+}
+
+// Runs solve, which fills previous with the fixed point of F, unless that
+// fixed point is in cache under the fingerprint of F for analysis. A computed
+// fixed point is added to the cache. Without a cache this is just solve().
+template<typename T, typename Solve>
+void solve_with_cache(resultCache* cache, Function &F, StringRef analysis, blockState<T>& previous, Solve solve){
+  if(!cache){
+    solve();
+    return;
+  }
+  phaseTimer lookup_timer("cache", "Look up and fill the result cache");
+  functionFingerprint fingerprint(F, analysis);
+  if(load_cached_fixed_point(*cache, fingerprint, previous)){
+    return;
+  }
+  lookup_timer.stop();
+  solve();
+  phaseTimer store_timer("cache", "Look up and fill the result cache");
+  store_cached_fixed_point(*cache, fingerprint, previous);
+}
+
+#endif
@@ -0,0 +1,272 @@
+// ===- Interference.h Interference graph and register pressure from liveness ---===//
+#ifndef DATAFLOW_INTERFERENCE_H
+#define DATAFLOW_INTERFERENCE_H
+
+#include "llvm/Analysis/LoopInfo.h"
+#include "Liveness.h"
+#include <vector>
+
+namespace liveness {
+  // Interference graph of the values of a function that need a register
+  // (arguments and instructions with a result), and the register pressure
+  // at each block, built from the block fixed point of LivenessDFA or
+  // LivenessSSA in one backward sweep per block. Two values interfere when
+  // one is live after the other is defined; in SSA form that is every pair
+  // live at the same point. The phis of a block are defined together at its
+  // top and the arguments together on entry. Values removed by an edit,
+  // null in an updated numbering, get no node.
+  //
+  // Edges are kept as sorted adjacency lists. A triangular bit matrix answers
+  // interferes() in constant time when it fits in max_matrix_bytes; beyond
+  // that the adjacency lists are searched instead.
+  class interferenceGraph{
+    public:
+      std::vector<Value*> nodes; // By node number
+
+      interferenceGraph(const valueNumbering& numbering, blockState<valueType>& fixed_point, uint64_t max_matrix_bytes = 64 << 20) : numbering(&numbering), blocks(fixed_point.numbering){
+        phaseTimer timer("interference", "Build the interference graph");
+        node_of.assign(numbering.size(), no_node);
+        for(unsigned idx = 0; idx < numbering.size(); idx++){
+          if(numbering.values[idx] && !numbering.values[idx]->getType()->isVoidTy()){
+            node_of[idx] = nodes.size();
+            nodes.push_back(numbering.values[idx]);
+          }
+        }
+        uint64_t bits = (uint64_t)nodes.size() * (nodes.size() - (nodes.empty() ? 0 : 1)) / 2;
+        if((bits + 7) / 8 <= max_matrix_bytes){
+          matrix.assign((bits + 63) / 64, 0);
+          has_matrix = true;
+        }
+        std::vector<std::pair<unsigned, unsigned>> edges;
+        block_pressure.assign(blocks->size(), 0);
+        live_position.assign(nodes.size(), 0);
+        for(unsigned bb_idx = 0; bb_idx < blocks->size(); bb_idx++){
+          sweep_block(bb_idx, fixed_point, edges);
+        }
+        build_adjacency(edges);
+        std::vector<unsigned>().swap(live);
+        std::vector<unsigned>().swap(live_position);
+      }
+
+      // Node number of v, or false if v needs no register
+      bool node(Value* v, unsigned& result) const{
+        auto it = numbering->indices.find(v);
+        result = it == numbering->indices.end() ? no_node : node_of[it->second];
+        return result != no_node;
+      }
+
+      bool interferes(Value* a, Value* b) const{
+        unsigned x, y;
+        if(!node(a, x) || !node(b, y) || x == y){
+          return false;
+        }
+        if(has_matrix){
+          uint64_t bit = matrix_bit(x, y);
+          return (matrix[bit / 64] >> (bit % 64)) & 1;
+        }
+        if(degree(x) > degree(y)){
+          std::swap(x, y);
+        }
+        ArrayRef<unsigned> row = neighbours(x);
+        return std::binary_search(row.begin(), row.end(), y);
+      }
+
+      // Nodes interfering with node n, in increasing order
+      ArrayRef<unsigned> neighbours(unsigned n) const{
+        return makeArrayRef(targets.data() + offsets[n], offsets[n + 1] - offsets[n]);
+      }
+
+      unsigned degree(unsigned n) const{
+        return offsets[n + 1] - offsets[n];
+      }
+
+      uint64_t edge_count() const{
+        return targets.size() / 2;
+      }
+
+      // Whether interferes() uses the bit matrix
+      bool uses_matrix() const{
+        return has_matrix;
+      }
+
+      // Most values needing a register at any one point of bb, counting a
+      // value being defined even if it is never used
+      unsigned max_pressure(BasicBlock* bb) const{
+        return block_pressure[blocks->index(bb)];
+      }
+
+      // Most values needing a register at any one point of L, nested loops
+      // included
+      unsigned max_pressure(const Loop& L) const{
+        unsigned result = 0;
+        for(BasicBlock* bb : L.blocks()){
+          result = std::max(result, max_pressure(bb));
+        }
+        return result;
+      }
+
+      unsigned max_pressure() const{
+        unsigned result = 0;
+        for(unsigned pressure : block_pressure){
+          result = std::max(result, pressure);
+        }
+        return result;
+      }
+
+    private:
+      enum : unsigned { no_node = ~0u };
+      const valueNumbering* numbering;
+      const blockNumbering* blocks;
+      std::vector<unsigned> node_of; // By value number
+      std::vector<uint64_t> matrix;
+      bool has_matrix = false;
+      std::vector<unsigned> offsets; // Into targets, one past the end for the last node
+      std::vector<unsigned> targets;
+      std::vector<unsigned> block_pressure;
+      // Nodes live at the current point of a sweep, as a sparse set: the
+      // members in any order, and by node the position of a member in them
+      std::vector<unsigned> live;
+      std::vector<unsigned> live_position;
+
+      static uint64_t matrix_bit(unsigned x, unsigned y){
+        if(x < y){
+          std::swap(x, y);
+        }
+        return (uint64_t)x * (x - 1) / 2 + y;
+      }
+
+      void add_edge(unsigned x, unsigned y, std::vector<std::pair<unsigned, unsigned>>& edges){
+        if(x == y){
+          return;
+        }
+        if(has_matrix){
+          uint64_t bit = matrix_bit(x, y);
+          uint64_t mask = uint64_t(1) << (bit % 64);
+          if(matrix[bit / 64] & mask){
+            return;
+          }
+          matrix[bit / 64] |= mask;
+        }
+        edges.push_back(std::make_pair(x, y));
+      }
+
+      bool is_live(unsigned n) const{
+        unsigned pos = live_position[n];
+        return pos < live.size() && live[pos] == n;
+      }
+
+      bool make_live(unsigned n){
+        if(is_live(n)){
+          return false;
+        }
+        live_position[n] = live.size();
+        live.push_back(n);
+        return true;
+      }
+
+      void make_dead(unsigned n){
+        if(!is_live(n)){
+          return;
+        }
+        unsigned last = live.back();
+        live[live_position[n]] = last;
+        live_position[last] = live_position[n];
+        live.pop_back();
+      }
+
+      unsigned node_of_value(Value* v) const{
+        return node_of[numbering->index(v)];
+      }
+
+      // Walks bb backward from its OUT: each definition interferes with
+      // everything live after it, then is removed and its operands added
+      void sweep_block(unsigned bb_idx, blockState<valueType>& fixed_point, std::vector<std::pair<unsigned, unsigned>>& edges){
+        const valueType& out = fixed_point.out(bb_idx);
+        live.clear();
+        for(unsigned bit = out.find_next(0); bit < out.words.size() * valueType::word_bits; bit = out.find_next(bit + 1)){
+          make_live(node_of[bit]);
+        }
+        unsigned pressure = live.size();
+        BasicBlock* bb = blocks->blocks[bb_idx];
+        auto interfere_with_live = [&](unsigned def){
+          for(unsigned n : live){
+            add_edge(def, n, edges);
+          }
+        };
+        for(auto inst = bb->rbegin(); inst != bb->rend(); ++inst){
+          if(isa<PHINode>(&*inst)){
+            break;
+          }
+          unsigned def = node_of_value((Value*)&*inst);
+          if(def != no_node){
+            make_dead(def);
+            pressure = std::max(pressure, (unsigned)live.size() + 1);
+            interfere_with_live(def);
+          }
+          for(const Use& u : inst->operands()){
+            Value* used = u.get();
+            if(isa<Instruction>(used) || isa<Argument>(used)){
+              make_live(node_of_value(used));
+            }
+          }
+          pressure = std::max(pressure, (unsigned)live.size());
+        }
+        // The phis are defined together, so they interfere with each other
+        // whether used or not, and with everything else live at the top
+        std::vector<unsigned> phi_nodes;
+        for(PHINode& phi : bb->phis()){
+          phi_nodes.push_back(node_of_value(&phi));
+          make_live(phi_nodes.back());
+        }
+        for(unsigned phi : phi_nodes){
+          interfere_with_live(phi);
+        }
+        // Arguments are defined together on entry
+        if(bb == &bb->getParent()->getEntryBlock()){
+          for(Argument& arg : bb->getParent()->args()){
+            unsigned n = node_of_value(&arg);
+            if(is_live(n)){
+              interfere_with_live(n);
+            }
+          }
+        }
+        block_pressure[bb_idx] = std::max(pressure, (unsigned)live.size());
+      }
+
+      // Sorts the edges into one adjacency list per node
+      void build_adjacency(std::vector<std::pair<unsigned, unsigned>>& edges){
+        offsets.assign(nodes.size() + 1, 0);
+        for(auto& edge : edges){
+          offsets[edge.first + 1]++;
+          offsets[edge.second + 1]++;
+        }
+        for(unsigned n = 0; n < nodes.size(); n++){
+          offsets[n + 1] += offsets[n];
+        }
+        targets.resize(offsets[nodes.size()]);
+        std::vector<unsigned> fill(offsets.begin(), offsets.end() - 1);
+        for(auto& edge : edges){
+          targets[fill[edge.first]++] = edge.second;
+          targets[fill[edge.second]++] = edge.first;
+        }
+        std::vector<std::pair<unsigned, unsigned>>().swap(edges);
+        // Without the matrix an edge can be found twice, by a phi or an
+        // argument defined together with its neighbour
+        unsigned write = 0;
+        for(unsigned n = 0; n < nodes.size(); n++){
+          unsigned begin = offsets[n], end = offsets[n + 1];
+          std::sort(targets.begin() + begin, targets.begin() + end);
+          offsets[n] = write;
+          for(unsigned pos = begin; pos < end; pos++){
+            if(pos == begin || targets[pos] != targets[pos - 1]){
+              targets[write++] = targets[pos];
+            }
+          }
+        }
+        offsets[nodes.size()] = write;
+        targets.resize(write);
+      }
+  };
+}
+
+#endif
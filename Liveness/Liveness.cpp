@@ -2,123 +2,50 @@
 #include "llvm/ADT/Statistic.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
 #include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/IR/CFG.h" // For iterating over predecessors of a basic block
 #include "llvm/Analysis/Dataflow.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/PassPlugin.h"
+#include "Liveness.h"
+#include "Interference.h"
+#include "LivenessAnalysis.h"
 #include <map>
 #include <set>
 
 using namespace llvm;
+using namespace liveness;
 
 #define DEBUG_TYPE "liveness"
-namespace {
-  class valueType : public std::set<Value*>{
-    public:
-      valueType operator ^ (valueType b){
-        valueType result(b);
-        result.insert(this->begin(),this->end());
-        return result;
-      }
-  };
-
-  class LivenessDFA : public dataFlow<valueType>{
-    private:
-      void construct_transfer_function_objects(Function& F){
-        for(auto&& bb : F.getBasicBlockList()){
-          transferFunction<valueType> tf;
-          BasicBlock* bb_pointer = &bb;
-          tf.basic_block = bb_pointer;
-          tf.is_forward = false;
-          tf.blockToTransferFunctionsMap = &allTransferFunctions;
-          tf.blockTransferFunction = [bb_pointer](valueType out){
-            valueType in(out);
-            for(auto inst = bb_pointer->rbegin(); inst != bb_pointer->rend(); ++inst){
-              if(isa<PHINode>(&*inst)){
-                break;
-              }
-              in.erase((Value*)&*inst);
-              for(const Use& u : inst->operands()){
-                Value* val = u.get();
-                if(isa<Instruction>(val) || isa<Argument>(val)){
-                  in.insert(val);
-                }
-              }
-            } 
-            return in;
-          };
-          if(isa<PHINode>(&*(bb_pointer->begin()))){
-            // Has phi nodes
-            tf.has_phi_nodes = true;
-            auto last_phi_inst = bb_pointer->begin();
-            while(isa<PHINode>(&*last_phi_inst)){
-              ++last_phi_inst;
-            }
-            --last_phi_inst; // This will be the last PHI instruction
-            for(BasicBlock* pred : predecessors(&bb)){
-              tf.transferMap[pred] = [bb_pointer,last_phi_inst, pred](valueType out){
-                valueType in(out);
-                auto bbiphi = last_phi_inst;
-                for(bbiphi = last_phi_inst; bbiphi != bb_pointer->begin(); --bbiphi){
-                  PHINode* phi = dyn_cast<PHINode>(&*bbiphi);
-                  in.erase((Value*)&*bbiphi);
-                  for(unsigned int idx = 0; idx < phi->getNumIncomingValues(); idx++){
-                    if(phi->getIncomingBlock(idx) == pred){
-                      Value* val = phi->getIncomingValue(idx);
-                      if(isa<Instruction>(val) || isa<Argument>(val)){
-                        in.insert(val);
-                      }
-                      break;
-                    }
-                  }
-                }
-                PHINode* phi = dyn_cast<PHINode>(&*bbiphi);
-                in.erase((Value*)&*bbiphi);
-                for(unsigned int idx = 0; idx < phi->getNumIncomingValues(); idx++){
-                  if(phi->getIncomingBlock(idx) == pred){
-                    Value* val = phi->getIncomingValue(idx);
-                    if(isa<Instruction>(val) || isa<Argument>(val)){
-                      in.insert(val);
-                    }
-                    break;
-                  }
-                }              
-                return in;
-              };   
-            }
-          }
-          allTransferFunctions[&bb] = tf;
-        }
-      }
-
-    public:
-      LivenessDFA(Function &F){
-        is_forward = false;
-        construct_transfer_function_objects(F);
-      }
-
-      std::map<Instruction*,valueType> propagate_to_instructions(Function& F, std::map<std::pair<BasicBlock*, bool>, valueType>& bbFixedPoint){
-        std::map<Instruction*, valueType> instructionFixedPoint;
-        for(auto&& bb : F.getBasicBlockList()){
-          valueType current = bbFixedPoint[std::make_pair(&bb,false)];
-          for(auto inst = bb.rbegin(); inst != bb.rend(); ++inst){
-            if(isa<PHINode>(&*inst)){
-              break;
-            }
-            current.erase((Value *)&*inst);
-            for(const Use& u: inst->operands()){
-              Value* used = u.get();
-              if(isa<Argument>(used) || isa<Instruction>(used)){
-                current.insert(used);
-              }
-            }
-            instructionFixedPoint[&*inst] = current;
-          }
-        }
-        return instructionFixedPoint;
-      }
-  };
 
+static cl::opt<solverStrategy> LivenessSolver("liveness-solver",
+    cl::desc("Fixed-point strategy for the Liveness pass"),
+    cl::init(WORKLIST), solverStrategyValues());
+static cl::opt<livenessEngine> LivenessEngine("liveness-engine",
+    cl::desc("How the Liveness pass computes its fixed point"),
+    cl::init(ITERATIVE), cl::values(
+      clEnumValN(ITERATIVE, "iterative", "Iterate the transfer functions to a fixed point"),
+      clEnumValN(SPARSE, "sparse", "Walk backward from the uses of each SSA value to its definition")));
+static cl::opt<unsigned> LivenessThreads("liveness-threads",
+    cl::desc("Threads used by -liveness-parallel and -liveness-solver=components (0 = all hardware threads)"),
+    cl::init(0));
+static cl::opt<outputMode> LivenessOutput("liveness-output",
+    cl::desc("What the Liveness pass prints"),
+    cl::init(FULL_OUTPUT), outputModeValues());
+static cl::opt<std::string> LivenessCacheDir("liveness-cache-dir",
+    cl::desc("Directory of an on-disk cache of Liveness fixed points, keyed by function structure"),
+    cl::value_desc("directory"));
+static cl::opt<unsigned> LivenessCacheSize("liveness-cache-size",
+    cl::desc("Size cap of -liveness-cache-dir in MiB; the least recently used entries are evicted"),
+    cl::init(256));
+static cl::opt<unsigned> LivenessMatrixSize("liveness-matrix-size",
+    cl::desc("MiB up to which -liveness-pressure keeps the interference graph as a bit matrix too"),
+    cl::init(64));
+namespace {
   // Hello - The first implementation, without getAnalysisUsage.
   struct Liveness : public FunctionPass {
     static char ID; // Pass identification, replacement for typeid
@@ -144,33 +71,46 @@ namespace {
     //   return result;
     // }
 
-    bool runOnFunction(Function &F) override {
-      LivenessDFA ld(F);
-      std::map<std::pair<BasicBlock*, bool>, valueType> previous;
-      for(auto& bb: F.getBasicBlockList()){
-        valueType set_in;
-        valueType set_out;
-        previous[std::make_pair(&bb,true)] = set_in;
-        previous[std::make_pair(&bb,false)] = set_out;
+    // Runs the analysis on F and prints the result to OS
+    static void analyzeFunction(Function &F, raw_ostream &OS){
+      LivenessInfo info(F, LivenessEngine, LivenessSolver, LivenessThreads, getLivenessResultCache());
+      printResults(info, F, OS);
+    }
+
+    // Prints info, the result of the analysis on F, as chosen by
+    // -liveness-output
+    static void printResults(LivenessInfo& info, Function& F, raw_ostream &OS){
+      resultEmitter emitter(F, OS, LivenessOutput);
+      if(emitter.mode == FULL_OUTPUT){
+        F.print(emitter.out());
+      }
+      phaseTimer print_timer("print", "Print results");
+      if(emitter.mode == SUMMARY_OUTPUT){
+        emit_block_summaries(emitter, F, info.fixed_point());
+        return;
+      }
+      instructionQuery<valueType>& query = info.instructions();
+      if(emitter.mode == JSON_OUTPUT){
+        emit_json(emitter, F, query);
+        return;
       }
-      F.print(outs());
-      ld.run_dataflow(F, previous);
-      std::map<Instruction*, valueType> instructionFixedPoint = ld.propagate_to_instructions(F, previous);
-      outs() << "Live Variable Analysis\n";
+      if(emitter.mode == NO_OUTPUT){
+        return;
+      }
+      raw_ostream& out = emitter.out();
+      out << "Live Variable Analysis\n";
       for(auto&& bb : F.getBasicBlockList()){
-        bb.printAsOperand(outs());
-        outs() << ":\n";
+        emitter.operand(&bb);
+        out << ":\n";
         for(auto inst = bb.begin(); inst != bb.end(); ++inst){
           if(!isa<PHINode>(&*inst)){
-            valueType liveVars = instructionFixedPoint[&*inst];
-            outs() << "{";
-            std::for_each(liveVars.begin(), liveVars.end(), [](Value* v){v->printAsOperand(outs()); outs() << ", ";});
-            outs() << "}\n";
+            print_lattice(emitter, query.valueAt(&*inst));
           }
-          inst->print(outs());
-          outs() << "\n";
+          emitter.instruction(*inst);
+          out << "\n";
         }
-        outs() << "\n\n";
+        out << "\n\n";
+        emitter.end_record();
       }
 
 
@@ -216,6 +156,85 @@ namespace {
       //     outs << *a << "\n";
       //   }
       // }
+    }
+
+    bool runOnFunction(Function &F) override {
+      analyzeFunction(F, outs());
+      return false;
+    }
+  };
+
+  // Register pressure: the most values live at once in each block and each
+  // loop, from the interference graph built on the liveness result
+  struct LivenessPressure : public FunctionPass {
+    static char ID;
+    LivenessPressure() : FunctionPass(ID) {}
+
+    // Prints the pressure of F, in the format chosen by -liveness-output
+    static void printPressure(LivenessInfo& info, Function& F, LoopInfo& LI, raw_ostream &OS){
+      interferenceGraph graph = info.interference((uint64_t)LivenessMatrixSize << 20);
+      resultEmitter emitter(F, OS, LivenessOutput);
+      if(emitter.mode == NO_OUTPUT){
+        return;
+      }
+      phaseTimer print_timer("print", "Print results");
+      SmallVector<Loop*, 8> loops = LI.getLoopsInPreorder();
+      if(emitter.mode == JSON_OUTPUT){
+        emitter.json_record([&](json::OStream& record){
+          record.attribute("values", (int64_t)graph.nodes.size());
+          record.attribute("interferences", (int64_t)graph.edge_count());
+          record.attribute("max_pressure", (int64_t)graph.max_pressure());
+          record.attributeObject("blocks", [&](){
+            for(BasicBlock& bb : F){
+              record.attribute(emitter.operand_name(&bb), (int64_t)graph.max_pressure(&bb));
+            }
+          });
+          record.attributeObject("loops", [&](){
+            for(Loop* L : loops){
+              record.attribute(emitter.operand_name(L->getHeader()), (int64_t)graph.max_pressure(*L));
+            }
+          });
+        });
+        return;
+      }
+      raw_ostream& out = emitter.out();
+      out << "Register pressure of " << F.getName() << ": " << graph.max_pressure() << " ("
+          << graph.nodes.size() << " values, " << graph.edge_count() << " interferences)\n";
+      if(emitter.mode == FULL_OUTPUT){
+        for(BasicBlock& bb : F){
+          emitter.operand(&bb);
+          out << " : " << graph.max_pressure(&bb) << "\n";
+        }
+      }
+      for(Loop* L : loops){
+        out << "loop ";
+        emitter.operand(L->getHeader());
+        out << " (depth " << L->getLoopDepth() << ") : " << graph.max_pressure(*L) << "\n";
+      }
+      out << "\n";
+      emitter.end_record();
+    }
+
+    void getAnalysisUsage(AnalysisUsage &AU) const override {
+      AU.addRequired<LoopInfoWrapperPass>();
+      AU.setPreservesAll();
+    }
+
+    bool runOnFunction(Function &F) override {
+      LivenessInfo info(F, LivenessEngine, LivenessSolver, LivenessThreads, getLivenessResultCache());
+      printPressure(info, F, getAnalysis<LoopInfoWrapperPass>().getLoopInfo(), outs());
+      return false;
+    }
+  };
+
+  // Module-level mode. Functions are independent for this intraprocedural
+  // analysis, so they are solved concurrently and their buffered output is
+  // emitted in module order.
+  struct LivenessParallel : public ModulePass {
+    static char ID;
+    LivenessParallel() : ModulePass(ID) {}
+    bool runOnModule(Module &M) override {
+      run_on_functions_in_parallel(M, LivenessThreads, Liveness::analyzeFunction, outs());
       return false;
     }
   };
@@ -223,6 +242,58 @@ namespace {
 
 char Liveness::ID = 0;
 static RegisterPass<Liveness> X("liveness", "Liveness Pass");
+char LivenessParallel::ID = 0;
+static RegisterPass<LivenessParallel> Y("liveness-parallel", "Liveness Pass, all functions in parallel");
+char LivenessPressure::ID = 0;
+static RegisterPass<LivenessPressure> Z("liveness-pressure", "Register pressure and interference graph from liveness");
+
+resultCache* getLivenessResultCache(){
+  static std::unique_ptr<resultCache> cache = LivenessCacheDir.empty() ? nullptr : std::unique_ptr<resultCache>(new resultCache(LivenessCacheDir, (uint64_t)LivenessCacheSize << 20));
+  return cache.get();
+}
+
+AnalysisKey LivenessAnalysis::Key;
+
+PreservedAnalyses LivenessPrinterPass::run(Function &F, FunctionAnalysisManager &FAM){
+  Liveness::printResults(FAM.getResult<LivenessAnalysis>(F), F, OS);
+  return PreservedAnalyses::all();
+}
+
+PreservedAnalyses LivenessPressurePrinterPass::run(Function &F, FunctionAnalysisManager &FAM){
+  LivenessPressure::printPressure(FAM.getResult<LivenessAnalysis>(F), F, FAM.getResult<LoopAnalysis>(F), OS);
+  return PreservedAnalyses::all();
+}
+
+// New pass manager: the options of the legacy pass configure the analysis,
+// and require<liveness> or invalidate<liveness> name it in a pipeline
+PassPluginLibraryInfo getLivenessPluginInfo(){
+  return {LLVM_PLUGIN_API_VERSION, "Liveness", LLVM_VERSION_STRING, [](PassBuilder &PB){
+    PB.registerAnalysisRegistrationCallback([](FunctionAnalysisManager &FAM){
+      FAM.registerPass([](){
+        return LivenessAnalysis(LivenessEngine, LivenessSolver, LivenessThreads, getLivenessResultCache());
+      });
+    });
+    PB.registerPipelineParsingCallback([](StringRef Name, FunctionPassManager &FPM, ArrayRef<PassBuilder::PipelineElement>){
+      if(Name == "print<liveness>"){
+        FPM.addPass(LivenessPrinterPass(outs()));
+        return true;
+      }
+      if(Name == "print<liveness-pressure>"){
+        FPM.addPass(LivenessPressurePrinterPass(outs()));
+        return true;
+      }
+      return parseAnalysisUtilityPasses<LivenessAnalysis>("liveness", Name, FPM);
+    });
+  }};
+}
+
+// Tools linking the pass in statically register it through
+// getLivenessPluginInfo instead
+#ifndef LLVM_LIVENESS_LINK_INTO_TOOLS
+extern "C" LLVM_ATTRIBUTE_WEAK PassPluginLibraryInfo llvmGetPassPluginInfo(){
+  return getLivenessPluginInfo();
+}
+#endif
 
 // namespace {
 //   // Hello2 - The second implementation with getAnalysisUsage implemented.
@@ -0,0 +1,191 @@
+// ===- Liveness.h Liveness solver, shared by the pass and the tools ---===//
+#ifndef DATAFLOW_LIVENESS_H
+#define DATAFLOW_LIVENESS_H
+
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/Analysis/Dataflow.h"
+#include <map>
+#include <set>
+
+namespace liveness {
+  typedef bitVectorSet<Value*> valueType;
+
+  // Live sets at each instruction, computed on demand from the block fixed
+  // point by walking the block backward from OUT. Phi nodes have no set;
+  // their uses are accounted for on the incoming edges.
+  inline instructionQuery<valueType> live_set_query(blockState<valueType> bbFixedPoint){
+    instructionQuery<valueType> query(std::move(bbFixedPoint), false, true, [](Instruction* inst, valueType& current){
+      if(isa<PHINode>(inst)){
+        return;
+      }
+      current.erase((Value *)inst);
+      for(const Use& u: inst->operands()){
+        Value* used = u.get();
+        if(isa<Argument>(used) || isa<Instruction>(used)){
+          current.insert(used);
+        }
+      }
+    });
+    query.has_value = [](Instruction* inst){
+      return !isa<PHINode>(inst);
+    };
+    return query;
+  }
+
+  class LivenessDFA : public genKillDataFlow<valueType, Value*, backwardDirection>{
+    private:
+      // Summarizes block bb_idx: walking backward, an instruction kills its
+      // own value and generates its operands. Phi nodes are summarized per
+      // incoming edge, generating only the value for that predecessor.
+      void summarize_block(unsigned bb_idx){
+        BasicBlock* bb_pointer = blocks.blocks[bb_idx];
+        genKillSummary<valueType, Value*>& summary = transfer.blockSummaries[bb_idx];
+        for(auto inst = bb_pointer->rbegin(); inst != bb_pointer->rend(); ++inst){
+          if(isa<PHINode>(&*inst)){
+            break;
+          }
+          summary.remove((Value*)&*inst);
+          for(const Use& u : inst->operands()){
+            Value* val = u.get();
+            if(isa<Instruction>(val) || isa<Argument>(val)){
+              summary.add(val);
+            }
+          }
+        }
+        ArrayRef<PHINode*> phis = blocks.phi_nodes(bb_idx);
+        if(!phis.empty()){
+          // Walking the phis backward, each kills itself and generates the
+          // value it takes along the edge
+          for(unsigned edge = blocks.pred_begin[bb_idx]; edge < blocks.pred_begin[bb_idx + 1]; edge++){
+            genKillSummary<valueType, Value*>& edge_summary = transfer.edgeSummaries[edge];
+            ArrayRef<Value*> incoming = blocks.incoming_values(edge);
+            for(unsigned phi_idx = phis.size(); phi_idx-- > 0;){
+              edge_summary.remove((Value*)phis[phi_idx]);
+              Value* val = incoming[phi_idx];
+              if(isa<Instruction>(val) || isa<Argument>(val)){
+                edge_summary.add(val);
+              }
+            }
+          }
+          transfer.hasEdgeSummaries[bb_idx] = true;
+        }
+      }
+
+      void construct_transfer_function_objects(Function& F){
+        init_summaries();
+        for(unsigned bb_idx = 0; bb_idx < blocks.size(); bb_idx++){
+          summarize_block(bb_idx);
+        }
+      }
+
+    public:
+      valueNumbering numbering;
+      LivenessDFA(Function &F){
+        number_blocks(F);
+        numbering.init(F);
+        top = valueType(&numbering, &arena);
+        construct_transfer_function_objects(F);
+      }
+
+      // Brings bbFixedPoint, the result before an edit of F, up to date.
+      // dirty lists the blocks whose instructions changed, including added
+      // blocks; only their summaries are rebuilt.
+      void reanalyze(Function &F, blockState<valueType>& bbFixedPoint, ArrayRef<BasicBlock*> dirty){
+        std::vector<unsigned> retired = numbering.update(F);
+        top = valueType(&numbering, &arena);
+        genKillDataFlow::reanalyze(F, bbFixedPoint, dirty, retired, [this](unsigned bb_idx){
+          summarize_block(bb_idx);
+        });
+      }
+
+      instructionQuery<valueType> make_instruction_query(blockState<valueType> bbFixedPoint){
+        return live_set_query(std::move(bbFixedPoint));
+      }
+  };
+
+  // The fixed point of LivenessDFA computed one value at a time: from each use
+  // the value is marked live backward through the predecessors until its
+  // definition is reached, so only the blocks where it is live are visited.
+  // Phis are treated as the edge summaries of LivenessDFA treat them: a phi
+  // operand is live out of its incoming block only, a phi is live into its
+  // own block but killed on every incoming edge, and the phis of a block read
+  // their operands in order, so an operand that is an earlier phi of the same
+  // block is not live along the edge.
+  class LivenessSSA : public dataFlowBase<valueType>{
+    public:
+      valueNumbering numbering;
+      LivenessSSA(Function &F){
+        number_blocks(F);
+        numbering.init(F);
+        top = valueType(&numbering, &arena);
+      }
+
+      // Fills previous, which must start out as initial_state(top), with the
+      // live-in and live-out set of every block
+      void run(blockState<valueType>& previous){
+        phaseTimer timer("solve", "Solve to a fixed point");
+        counters = solverCounters();
+        counters.iterations = 1;
+        std::vector<unsigned> worklist; // Blocks the current value is live into
+        for(unsigned value = 0; value < numbering.size(); value++){
+          Value* v = numbering.values[value];
+          Instruction* def = dyn_cast<Instruction>(v);
+          unsigned def_block = def ? blocks.index(def->getParent()) : blocks.size();
+          bool def_is_phi = def && isa<PHINode>(def);
+          // Live out of block idx: live into it too unless defined there by
+          // an instruction the block summary kills
+          auto live_out = [&](unsigned idx){
+            if(previous.out(idx).test_and_set(value)){
+              counters.changes++;
+              if(idx != def_block || def_is_phi){
+                worklist.push_back(idx);
+              }
+            }
+          };
+          for(const Use& u : v->uses()){
+            Instruction* user = dyn_cast<Instruction>(u.getUser());
+            if(!user){
+              continue;
+            }
+            if(PHINode* phi = dyn_cast<PHINode>(user)){
+              if(def_is_phi && def->getParent() == phi->getParent() && def->comesBefore(phi)){
+                continue;
+              }
+              live_out(blocks.index(phi->getIncomingBlock(u)));
+              continue;
+            }
+            if(def && !def_is_phi && def->getParent() == user->getParent() && def->comesBefore(user)){
+              continue;
+            }
+            worklist.push_back(blocks.index(user->getParent()));
+          }
+          while(!worklist.empty()){
+            unsigned idx = worklist.back();
+            worklist.pop_back();
+            if(!previous.in(idx).test_and_set(value)){
+              continue;
+            }
+            counters.block_evaluations++;
+            counters.changes++;
+            if(idx == def_block && def_is_phi){
+              continue; // Killed on the incoming edges
+            }
+            for(unsigned pred : blocks.pred_indices(idx)){
+              live_out(pred);
+            }
+          }
+        }
+        if(AreStatisticsEnabled()){
+          record_statistics(previous);
+        }
+      }
+
+      instructionQuery<valueType> make_instruction_query(blockState<valueType> bbFixedPoint){
+        return live_set_query(std::move(bbFixedPoint));
+      }
+  };
+}
+
+#endif
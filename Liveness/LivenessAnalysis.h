@@ -0,0 +1,178 @@
+// ===- LivenessAnalysis.h Liveness for the new pass manager ---===//
+#ifndef DATAFLOW_LIVENESS_ANALYSIS_H
+#define DATAFLOW_LIVENESS_ANALYSIS_H
+
+#include "llvm/IR/PassManager.h"
+#include "llvm/Passes/PassPlugin.h"
+#include "Liveness.h"
+#include "Interference.h"
+#include <memory>
+
+namespace liveness {
+  enum livenessEngine{
+    ITERATIVE, // The generic fixed-point solver
+    SPARSE // Per-value backward walks from the uses
+  };
+
+  // Result of LivenessAnalysis: the block fixed point of one function, and
+  // the solver whose numbering and arena its sets live in. Live sets at
+  // instructions are replayed from the block boundaries on demand.
+  class LivenessInfo{
+    public:
+      // With a cache, a fixed point stored for a function of the same
+      // structure is used instead of solving
+      LivenessInfo(Function &F, livenessEngine engine = ITERATIVE, solverStrategy strategy = WORKLIST, unsigned threads = 0, resultCache* cache = nullptr) : engine(engine), strategy(strategy), threads(threads), cache(cache) {
+        phaseTimer construct_timer("construct", "Construct transfer functions");
+        if(engine == SPARSE){
+          sparse.reset(new LivenessSSA(F));
+          construct_timer.stop();
+          blockState<valueType> previous = sparse->initial_state(sparse->top);
+          solve_with_cache(cache, F, "liveness", previous, [&](){
+            sparse->run(previous);
+          });
+          query.reset(new instructionQuery<valueType>(live_set_query(std::move(previous))));
+          return;
+        }
+        iterative.reset(new LivenessDFA(F));
+        construct_timer.stop();
+        iterative->strategy = strategy;
+        iterative->threads = threads;
+        blockState<valueType> previous = iterative->initial_state(iterative->top);
+        solve_with_cache(cache, F, "liveness", previous, [&](){
+          iterative->run_dataflow(F, previous);
+        });
+        query.reset(new instructionQuery<valueType>(live_set_query(std::move(previous))));
+      }
+
+      blockState<valueType>& fixed_point(){
+        return query->fixed_point;
+      }
+
+      const valueType& live_in(BasicBlock* bb){
+        return query->fixed_point.in(bb);
+      }
+
+      const valueType& live_out(BasicBlock* bb){
+        return query->fixed_point.out(bb);
+      }
+
+      bool is_live_in(Value* v, BasicBlock* bb){
+        return contains(live_in(bb), v);
+      }
+
+      bool is_live_out(Value* v, BasicBlock* bb){
+        return contains(live_out(bb), v);
+      }
+
+      // Values live just before inst; phi nodes have no set. The reference
+      // stays valid until the next instruction query.
+      const valueType& live_before(Instruction* inst){
+        return query->valueAt(inst);
+      }
+
+      instructionQuery<valueType>& instructions(){
+        return *query;
+      }
+
+      const solverCounters& counters() const{
+        return engine == SPARSE ? sparse->counters : iterative->counters;
+      }
+
+      // Interference graph and register pressure of F, built from the block
+      // fixed point in one sweep
+      interferenceGraph interference(uint64_t max_matrix_bytes = 64 << 20){
+        return interferenceGraph(engine == SPARSE ? sparse->numbering : iterative->numbering, query->fixed_point, max_matrix_bytes);
+      }
+
+      // Brings the result up to date after a transform edited F, so that the
+      // transform can keep LivenessAnalysis preserved. dirty lists the blocks
+      // whose instructions changed, including added blocks. The sparse engine
+      // has no incremental form and solves F again, with the same options and
+      // cache.
+      void update(Function &F, ArrayRef<BasicBlock*> dirty){
+        if(engine == SPARSE){
+          query.reset();
+          *this = LivenessInfo(F, SPARSE, strategy, threads, cache);
+          return;
+        }
+        blockState<valueType> previous = std::move(query->fixed_point);
+        iterative->reanalyze(F, previous, dirty);
+        query.reset(new instructionQuery<valueType>(live_set_query(std::move(previous))));
+      }
+
+      // Liveness reads only the instructions and the CFG of F, so the result
+      // stays valid exactly when the analysis itself, or every analysis of
+      // the function, is preserved
+      bool invalidate(Function &F, const PreservedAnalyses &PA, FunctionAnalysisManager::Invalidator &);
+
+    private:
+      livenessEngine engine;
+      solverStrategy strategy;
+      unsigned threads;
+      resultCache* cache;
+      std::unique_ptr<LivenessDFA> iterative;
+      std::unique_ptr<LivenessSSA> sparse;
+      std::unique_ptr<instructionQuery<valueType>> query;
+
+      static bool contains(const valueType& set, Value* v){
+        return set.numbering->indices.count(v) && set.count(v);
+      }
+  };
+
+  // Computes LivenessInfo once per function; the analysis manager caches it
+  // until a pass does not preserve it
+  class LivenessAnalysis : public AnalysisInfoMixin<LivenessAnalysis>{
+    public:
+      typedef LivenessInfo Result;
+      livenessEngine engine;
+      solverStrategy strategy;
+      unsigned threads;
+      resultCache* cache;
+
+      LivenessAnalysis(livenessEngine engine = ITERATIVE, solverStrategy strategy = WORKLIST, unsigned threads = 0, resultCache* cache = nullptr) : engine(engine), strategy(strategy), threads(threads), cache(cache) {}
+
+      Result run(Function &F, FunctionAnalysisManager &){
+        return LivenessInfo(F, engine, strategy, threads, cache);
+      }
+
+    private:
+      friend AnalysisInfoMixin<LivenessAnalysis>;
+      static AnalysisKey Key;
+  };
+
+  inline bool LivenessInfo::invalidate(Function &F, const PreservedAnalyses &PA, FunctionAnalysisManager::Invalidator &){
+    auto checker = PA.getChecker<LivenessAnalysis>();
+    return !checker.preserved() && !checker.preservedSet<AllAnalysesOn<Function>>();
+  }
+
+  // print<liveness>: prints the cached LivenessAnalysis result in the format
+  // chosen by -liveness-output
+  class LivenessPrinterPass : public PassInfoMixin<LivenessPrinterPass>{
+    public:
+      explicit LivenessPrinterPass(raw_ostream &OS) : OS(OS) {}
+      PreservedAnalyses run(Function &F, FunctionAnalysisManager &FAM);
+
+    private:
+      raw_ostream &OS;
+  };
+
+  // print<liveness-pressure>: prints the register pressure of each block and
+  // loop, and the size of the interference graph
+  class LivenessPressurePrinterPass : public PassInfoMixin<LivenessPressurePrinterPass>{
+    public:
+      explicit LivenessPressurePrinterPass(raw_ostream &OS) : OS(OS) {}
+      PreservedAnalyses run(Function &F, FunctionAnalysisManager &FAM);
+
+    private:
+      raw_ostream &OS;
+  };
+}
+
+// Registers LivenessAnalysis as "liveness" and the printers as
+// "print<liveness>" and "print<liveness-pressure>" with a PassBuilder
+PassPluginLibraryInfo getLivenessPluginInfo();
+
+// The cache set up by -liveness-cache-dir, or nullptr
+resultCache* getLivenessResultCache();
+
+#endif
@@ -0,0 +1,347 @@
+// ===- Andersen.h Flow-insensitive may point-to solver, shared by the pass and the tools ---===//
+#ifndef DATAFLOW_ANDERSEN_H
+#define DATAFLOW_ANDERSEN_H
+
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SparseBitVector.h"
+#include "llvm/IR/InstIterator.h"
+#include "Maypoint.h"
+#include <deque>
+#include <vector>
+
+namespace maypoint {
+  // Work done by one andersenSolver::solve call
+  struct andersenCounters{
+    unsigned long nodes = 0;
+    unsigned long constraints = 0;
+    unsigned long propagations = 0; // Nodes that pushed new elements along their edges
+    unsigned long copy_edges = 0; // Including those added for loads and stores
+    unsigned long cycle_searches = 0;
+    unsigned long collapsed = 0; // Nodes merged into another node of a cycle
+  };
+
+  // Flow-insensitive counterpart of mayPoint: one points-to set per value,
+  // valid at every program point. The instructions mayPoint interprets become
+  // inclusion constraints
+  //   alloca a                 a includes {a}
+  //   getelementptr g, p       g includes {p}
+  //   bitcast, select, phi x   x includes y for each pointer operand y
+  //   load x, p                x includes *p
+  //   store v, p               *p includes v
+  // which are solved over a graph of copy edges with a worklist. A node pushes
+  // only the elements added since it was last processed (difference
+  // propagation). When pushing along an edge leaves both ends with equal sets,
+  // the solver searches for a cycle through that edge and merges its nodes
+  // (lazy cycle detection); the cycles of the initial graph are merged
+  // before solving.
+  class andersenSolver{
+    public:
+      latticeArena arena; // Declared first so that it is destroyed last
+      pointsToContext context;
+      andersenCounters counters;
+
+      andersenSolver(Function& F) : context(arena) {
+        context.numbering.init(F);
+        for(inst_iterator I = inst_begin(F); I != inst_end(F); ++I){
+          add_constraints(&*I);
+        }
+      }
+
+      // Points-to set of every value. The map shares the context of the
+      // solver and must not outlive it.
+      valueType solve(){
+        std::vector<unsigned> roots;
+        for(unsigned idx = 0; idx < nodes.size(); idx++){
+          roots.push_back(idx);
+        }
+        collapse_cycles(roots);
+        for(unsigned idx = 0; idx < nodes.size(); idx++){
+          if(find(idx) == idx && !nodes[idx].points_to.empty()){
+            enqueue(idx);
+          }
+        }
+        while(!worklist.empty()){
+          unsigned idx = worklist.front();
+          worklist.pop_front();
+          queued[idx] = false;
+          if(find(idx) == idx){
+            propagate(idx);
+          }
+        }
+        counters.nodes = nodes.size();
+        valueType result(&context);
+        DenseMap<unsigned, pointsToSet> interned; // By representative
+        SmallVector<unsigned, 32> elements;
+        for(unsigned idx = 0; idx < nodes.size(); idx++){
+          unsigned representative = find(idx);
+          auto it = interned.find(representative);
+          if(it == interned.end()){
+            elements.clear();
+            for(unsigned element : nodes[representative].points_to){
+              elements.push_back(element);
+            }
+            it = interned.insert(std::make_pair(representative, context.intern(elements))).first;
+          }
+          result.set(idx, it->second);
+        }
+        return result;
+      }
+
+    private:
+      struct node{
+        SparseBitVector<> points_to; // Value numbers
+        SparseBitVector<> propagated; // Elements already pushed along copy_to
+        SparseBitVector<> copy_to; // Nodes including this one; may name merged nodes
+        SmallVector<unsigned, 2> loads; // x for each load x = *this
+        SmallVector<unsigned, 2> stores; // v for each store *this = v
+      };
+
+      std::vector<node> nodes; // Indexed by value number
+      std::vector<unsigned> representative; // Union-find over merged nodes
+      std::deque<unsigned> worklist;
+      std::vector<bool> queued;
+      DenseSet<std::pair<unsigned, unsigned>> searched_edges;
+
+      unsigned node_of(Value* v){
+        unsigned idx = context.numbering.number(v);
+        if(idx >= nodes.size()){
+          nodes.resize(idx + 1);
+          queued.resize(idx + 1, false);
+          while(representative.size() <= idx){
+            representative.push_back(representative.size());
+          }
+        }
+        return idx;
+      }
+
+      unsigned find(unsigned idx){
+        unsigned root = idx;
+        while(representative[root] != root){
+          root = representative[root];
+        }
+        while(representative[idx] != root){
+          unsigned next = representative[idx];
+          representative[idx] = root;
+          idx = next;
+        }
+        return root;
+      }
+
+      void enqueue(unsigned idx){
+        if(!queued[idx]){
+          queued[idx] = true;
+          worklist.push_back(idx);
+        }
+      }
+
+      void add_constraints(Instruction* inst){
+        if(isa<AllocaInst>(inst)){
+          unsigned self = node_of(inst);
+          nodes[self].points_to.set(self);
+          counters.constraints++;
+          return;
+        }
+        if(BitCastInst* bit_cast_inst = dyn_cast<BitCastInst>(inst)){
+          if(isa<PointerType>(bit_cast_inst->getSrcTy()) && isa<PointerType>(bit_cast_inst->getDestTy())){
+            add_copy(node_of(bit_cast_inst->getOperand(0)), node_of(inst));
+            counters.constraints++;
+          }
+          return;
+        }
+        if(GetElementPtrInst* get_elem_ptr_inst = dyn_cast<GetElementPtrInst>(inst)){
+          unsigned pointer = node_of(get_elem_ptr_inst->getPointerOperand());
+          nodes[node_of(inst)].points_to.set(pointer);
+          counters.constraints++;
+          return;
+        }
+        if(isa<LoadInst>(inst)){
+          if(inst->getType()->isPointerTy()){
+            unsigned self = node_of(inst);
+            unsigned address = node_of(inst->getOperand(0));
+            nodes[address].loads.push_back(self);
+            counters.constraints++;
+          }
+          return;
+        }
+        if(StoreInst* store_inst = dyn_cast<StoreInst>(inst)){
+          if(store_inst->getValueOperand()->getType()->isPointerTy()){
+            unsigned value = node_of(store_inst->getValueOperand());
+            unsigned address = node_of(store_inst->getPointerOperand());
+            nodes[address].stores.push_back(value);
+            counters.constraints++;
+          }
+          return;
+        }
+        if(SelectInst* select_inst = dyn_cast<SelectInst>(inst)){
+          if(inst->getType()->isPointerTy()){
+            unsigned self = node_of(inst);
+            add_copy(node_of(select_inst->getTrueValue()), self);
+            add_copy(node_of(select_inst->getFalseValue()), self);
+            counters.constraints += 2;
+          }
+          return;
+        }
+        if(isa<PHINode>(inst)){
+          if(inst->getType()->isPointerTy()){
+            unsigned self = node_of(inst);
+            for(const Use& u : inst->operands()){
+              add_copy(node_of(u.get()), self);
+              counters.constraints++;
+            }
+          }
+          return;
+        }
+      }
+
+      // Adds the edge src -> dst and pushes all of src along it
+      void add_copy(unsigned src, unsigned dst){
+        src = find(src);
+        dst = find(dst);
+        if(src == dst || !nodes[src].copy_to.test_and_set(dst)){
+          return;
+        }
+        counters.copy_edges++;
+        if(nodes[dst].points_to |= nodes[src].points_to){
+          enqueue(dst);
+        }
+      }
+
+      void propagate(unsigned idx){
+        SparseBitVector<> delta = nodes[idx].points_to;
+        delta.intersectWithComplement(nodes[idx].propagated);
+        if(delta.empty()){
+          return;
+        }
+        nodes[idx].propagated = nodes[idx].points_to;
+        counters.propagations++;
+        // New targets of loads and stores through this node become copy edges.
+        // Targets merged into one node need the edges only once.
+        if(!nodes[idx].loads.empty() || !nodes[idx].stores.empty()){
+          SparseBitVector<> targets;
+          for(unsigned target : delta){
+            targets.set(find(target));
+          }
+          for(unsigned target : targets){
+            for(unsigned pos = 0; pos < nodes[idx].loads.size(); pos++){
+              add_copy(target, nodes[idx].loads[pos]);
+            }
+            for(unsigned pos = 0; pos < nodes[idx].stores.size(); pos++){
+              add_copy(nodes[idx].stores[pos], target);
+            }
+          }
+        }
+        // Edges to merged nodes are redirected to their representative
+        SparseBitVector<> copy_to;
+        for(unsigned succ : nodes[idx].copy_to){
+          succ = find(succ);
+          if(succ != idx){
+            copy_to.set(succ);
+          }
+        }
+        nodes[idx].copy_to = copy_to;
+        SmallVector<unsigned, 4> search_from;
+        for(unsigned succ : copy_to){
+          if(nodes[succ].points_to |= delta){
+            enqueue(succ);
+          }
+          if(nodes[succ].points_to == nodes[idx].points_to && searched_edges.insert(std::make_pair(idx, succ)).second){
+            search_from.push_back(succ);
+          }
+        }
+        if(!search_from.empty()){
+          collapse_cycles(search_from);
+        }
+      }
+
+      std::vector<unsigned> successors(unsigned idx){
+        std::vector<unsigned> result;
+        for(unsigned succ : nodes[idx].copy_to){
+          succ = find(succ);
+          if(succ != idx){
+            result.push_back(succ);
+          }
+        }
+        return result;
+      }
+
+      // Tarjan's algorithm over the copy graph reachable from roots, merging
+      // every strongly connected component into one node
+      void collapse_cycles(ArrayRef<unsigned> roots){
+        counters.cycle_searches++;
+        struct frame{
+          unsigned node;
+          std::vector<unsigned> succs;
+          unsigned pos;
+        };
+        DenseMap<unsigned, unsigned> index;
+        DenseMap<unsigned, unsigned> low;
+        DenseSet<unsigned> on_stack;
+        std::vector<unsigned> component_stack;
+        std::vector<frame> call_stack;
+        auto visit = [&](unsigned idx){
+          unsigned number = index.size();
+          index[idx] = number;
+          low[idx] = number;
+          component_stack.push_back(idx);
+          on_stack.insert(idx);
+          call_stack.push_back(frame{idx, successors(idx), 0});
+        };
+        for(unsigned root : roots){
+          root = find(root);
+          if(index.count(root)){
+            continue;
+          }
+          visit(root);
+          while(!call_stack.empty()){
+            frame& top = call_stack.back();
+            if(top.pos < top.succs.size()){
+              unsigned succ = top.succs[top.pos++];
+              unsigned from = top.node;
+              if(!index.count(succ)){
+                visit(succ);
+              }
+              else if(on_stack.count(succ)){
+                low[from] = std::min(low[from], index[succ]);
+              }
+              continue;
+            }
+            unsigned idx = top.node;
+            call_stack.pop_back();
+            if(!call_stack.empty()){
+              unsigned parent = call_stack.back().node;
+              low[parent] = std::min(low[parent], low[idx]);
+            }
+            if(low[idx] != index[idx]){
+              continue;
+            }
+            unsigned member;
+            do{
+              member = component_stack.back();
+              component_stack.pop_back();
+              on_stack.erase(member);
+              if(member != idx){
+                merge(idx, member);
+              }
+            } while(member != idx);
+          }
+        }
+      }
+
+      void merge(unsigned into, unsigned from){
+        representative[from] = into;
+        node& target = nodes[into];
+        node& source = nodes[from];
+        target.points_to |= source.points_to;
+        // Each side pushed its own elements along its own edges only
+        target.propagated &= source.propagated;
+        target.copy_to |= source.copy_to;
+        target.loads.append(source.loads.begin(), source.loads.end());
+        target.stores.append(source.stores.begin(), source.stores.end());
+        source = node();
+        counters.collapsed++;
+        enqueue(into);
+      }
+  };
+}
+
+#endif
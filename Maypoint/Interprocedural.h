@@ -0,0 +1,488 @@
+// ===- Interprocedural.h Bottom-up points-to summaries over the call graph, shared by the pass and the tools ---===//
+#ifndef DATAFLOW_INTERPROCEDURAL_H
+#define DATAFLOW_INTERPROCEDURAL_H
+
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SCCIterator.h"
+#include "llvm/Analysis/CallGraph.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/ThreadPool.h"
+#include "Maypoint.h"
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace maypoint {
+  // Reads the summary of F off its fixed point, solved with the seeds and
+  // summaries of the interprocedural mode: the blocks that return are joined,
+  // and what an argument or a global points to beyond itself is what F
+  // stored there. Storage allocated in F becomes local, and what that
+  // storage holds is followed for as long as it reaches more of it.
+  inline pointsToSummary summarize(Function& F, pointsToContext& context, blockState<valueType>& fixed_point){
+    pointsToSummary summary;
+    valueType exit(&context);
+    pointsToSet returned = nullptr;
+    for(unsigned idx = 0; idx < fixed_point.values.size(); idx++){
+      ReturnInst* ret = dyn_cast<ReturnInst>(fixed_point.numbering->blocks[idx]->getTerminator());
+      if(!ret){
+        continue;
+      }
+      const valueType& out = fixed_point.values[idx].out;
+      exit.join(out);
+      if(ret->getReturnValue() && ret->getReturnValue()->getType()->isPointerTy()){
+        returned = context.unite(returned, out.get(ret->getReturnValue()));
+      }
+    }
+    std::vector<Instruction*> escaped;
+    DenseSet<Instruction*> seen;
+    auto translate = [&](pointsToSet set, Value* self, summarySet& result){
+      if(!set){
+        return;
+      }
+      if(set == unknownSet()){
+        result.unknown = true;
+        return;
+      }
+      for(unsigned x : *set){
+        Value* target = context.numbering.values[x];
+        if(target == self){
+          continue;
+        }
+        if(Instruction* inst = dyn_cast<Instruction>(target)){
+          result.local = true;
+          if(seen.insert(inst).second){
+            escaped.push_back(inst);
+          }
+        }
+        else{
+          result.targets.push_back(target);
+        }
+      }
+      llvm::sort(result.targets);
+      result.targets.erase(std::unique(result.targets.begin(), result.targets.end()), result.targets.end());
+    };
+    exit.for_each([&](unsigned idx, pointsToSet points_to){
+      Value* key = context.numbering.values[idx];
+      if(!isa<Argument>(key) && !isa<GlobalVariable>(key)){
+        return;
+      }
+      summarySet stored;
+      translate(points_to, key, stored);
+      if(!stored.empty()){
+        summary.stores.push_back(std::make_pair(key, std::move(stored)));
+      }
+    });
+    llvm::sort(summary.stores, [](const std::pair<Value*, summarySet>& a, const std::pair<Value*, summarySet>& b){
+      return a.first < b.first;
+    });
+    translate(returned, nullptr, summary.returned);
+    translate(exit.anywhere, nullptr, summary.anywhere);
+    for(unsigned pos = 0; pos < escaped.size(); pos++){
+      translate(exit.get(escaped[pos]), nullptr, summary.locals);
+    }
+    return summary;
+  }
+
+  // Name of v that is the same in every run: "%n" for argument n of the
+  // summarised function, "@name" for a named global. Other values have none.
+  inline bool stable_name(Value* v, std::string& name){
+    if(Argument* arg = dyn_cast<Argument>(v)){
+      name = "%" + utostr(arg->getArgNo());
+      return true;
+    }
+    if(isa<GlobalValue>(v) && v->hasName()){
+      name = ("@" + v->getName()).str();
+      return true;
+    }
+    return false;
+  }
+
+  // Hashes summary by stable names into hash, or returns false if a target
+  // has none
+  inline bool hash_summary(MD5& hash, const pointsToSummary& summary){
+    auto describe = [](const summarySet& set, std::string& text){
+      std::vector<std::string> names;
+      for(Value* target : set.targets){
+        names.emplace_back();
+        if(!stable_name(target, names.back())){
+          return false;
+        }
+      }
+      llvm::sort(names);
+      text = (set.local ? "L" : "") + std::string(set.unknown ? "U" : "") + ":" + llvm::join(names, ",");
+      return true;
+    };
+    std::vector<std::string> lines;
+    for(auto& store : summary.stores){
+      std::string key, targets;
+      if(!stable_name(store.first, key) || !describe(store.second, targets)){
+        return false;
+      }
+      lines.push_back(key + "=" + targets);
+    }
+    llvm::sort(lines);
+    std::string returned, locals, anywhere;
+    if(!describe(summary.returned, returned) || !describe(summary.locals, locals) || !describe(summary.anywhere, anywhere)){
+      return false;
+    }
+    lines.push_back("return=" + returned);
+    lines.push_back("local=" + locals);
+    lines.push_back("anywhere=" + anywhere);
+    for(const std::string& line : lines){
+      hash.update(line);
+      hash.update(StringRef("\0", 1));
+    }
+    return true;
+  }
+
+  // Analysis name for caching results of F that depend on the summaries of
+  // its callees: analysis followed by a hash of those summaries in the order
+  // F first calls them. The fingerprint of F tells its callees apart only by
+  // that order, so together they identify the result. Summaries name
+  // globals, which the fingerprint numbers by first use, so the names of the
+  // globals F uses are hashed too. Returns "" if a summary cannot be hashed.
+  inline std::string summary_cache_tag(Function& F, const summaryTable& summaries, StringRef analysis){
+    MD5 hash;
+    DenseSet<const Value*> seen;
+    for(Instruction& inst : instructions(F)){
+      for(Value* operand : inst.operands()){
+        if(isa<GlobalValue>(operand) && seen.insert(operand).second){
+          hash.update(operand->getName());
+          hash.update(StringRef("\0", 1));
+        }
+      }
+    }
+    seen.clear();
+    for(Instruction& inst : instructions(F)){
+      CallBase* call = dyn_cast<CallBase>(&inst);
+      Function* callee = call ? call->getCalledFunction() : nullptr;
+      if(!callee || !seen.insert(callee).second){
+        continue;
+      }
+      auto it = summaries.find(callee);
+      if(it == summaries.end()){
+        hash.update("-");
+        continue;
+      }
+      if(!hash_summary(hash, it->second)){
+        return "";
+      }
+    }
+    MD5::MD5Result digest;
+    hash.final(digest);
+    return (analysis + "-" + digest.digest()).str();
+  }
+
+  // Cache codec of summaries. A target is written as the code of the value
+  // in the fingerprint of its function, or, for globals only the callees
+  // use, by name.
+  inline bool encode_summary_set(cacheWriter& writer, const functionFingerprint& fingerprint, const summarySet& set){
+    writer.write((set.local ? 1 : 0) | (set.unknown ? 2 : 0));
+    writer.write(set.targets.size());
+    for(Value* target : set.targets){
+      unsigned code;
+      if(fingerprint.code(target, code)){
+        writer.write(0);
+        writer.write(code);
+        continue;
+      }
+      if(!isa<GlobalValue>(target) || !target->hasName()){
+        return false;
+      }
+      writer.write(1);
+      writer.write_string(target->getName());
+    }
+    return true;
+  }
+
+  inline bool decode_summary_set(cacheReader& reader, const functionFingerprint& fingerprint, Module& M, summarySet& set){
+    uint64_t flags = reader.read();
+    set.local = flags & 1;
+    set.unknown = flags & 2;
+    uint64_t count = reader.read();
+    for(uint64_t pos = 0; pos < count && !reader.failed; pos++){
+      Value* target = nullptr;
+      if(reader.read() == 0){
+        uint64_t code = reader.read();
+        if(code < fingerprint.values.size() && !isa<Instruction>(fingerprint.values[code])){
+          target = fingerprint.values[code];
+        }
+      }
+      else{
+        target = M.getNamedValue(reader.read_string());
+      }
+      if(!target){
+        return false;
+      }
+      set.targets.push_back(target);
+    }
+    llvm::sort(set.targets);
+    return !reader.failed;
+  }
+
+  inline bool encode_summary(cacheWriter& writer, const functionFingerprint& fingerprint, const pointsToSummary& summary){
+    writer.write(summary.stores.size());
+    for(auto& store : summary.stores){
+      unsigned code;
+      if(!fingerprint.code(store.first, code) && !isa<GlobalValue>(store.first)){
+        return false;
+      }
+      summarySet key;
+      key.targets.push_back(store.first);
+      if(!encode_summary_set(writer, fingerprint, key) || !encode_summary_set(writer, fingerprint, store.second)){
+        return false;
+      }
+    }
+    return encode_summary_set(writer, fingerprint, summary.returned) && encode_summary_set(writer, fingerprint, summary.locals) &&
+           encode_summary_set(writer, fingerprint, summary.anywhere);
+  }
+
+  inline bool decode_summary(cacheReader& reader, const functionFingerprint& fingerprint, Module& M, pointsToSummary& summary){
+    uint64_t count = reader.read();
+    for(uint64_t pos = 0; pos < count && !reader.failed; pos++){
+      summarySet key, stored;
+      if(!decode_summary_set(reader, fingerprint, M, key) || key.targets.size() != 1 || !decode_summary_set(reader, fingerprint, M, stored)){
+        return false;
+      }
+      summary.stores.push_back(std::make_pair(key.targets[0], std::move(stored)));
+    }
+    llvm::sort(summary.stores, [](const std::pair<Value*, summarySet>& a, const std::pair<Value*, summarySet>& b){
+      return a.first < b.first;
+    });
+    return decode_summary_set(reader, fingerprint, M, summary.returned) && decode_summary_set(reader, fingerprint, M, summary.locals) &&
+           decode_summary_set(reader, fingerprint, M, summary.anywhere) && reader.at_end();
+  }
+
+  // Computes the summary of every defined function of a module, callees
+  // first, over the strongly connected components of the call graph. A
+  // component is solved once all the components it calls are; independent
+  // components are solved concurrently. The functions of a recursive
+  // component are solved in turn, starting from empty summaries, until none
+  // of their summaries grows. Summaries of non-recursive functions are kept
+  // in the cache, keyed by the function's structure and its callees'
+  // summaries, so an unchanged function below unchanged callees is not solved
+  // again.
+  class summarySolver{
+    public:
+      summaryTable summaries;
+      std::atomic<unsigned long> solved{0}; // Function solves, including repeats within components
+      std::atomic<unsigned long> cached{0}; // Summaries read from the cache
+
+      summarySolver(Module& M, solverStrategy strategy = WORKLIST, precisionBudget budget = precisionBudget(), resultCache* cache = nullptr) : M(M), strategy(strategy), budget(budget), cache(cache) {}
+
+      // threads: 0 = all hardware threads
+      void run(unsigned threads){
+        phaseTimer timer("summaries", "Compute interprocedural summaries");
+        CallGraph graph(M);
+        std::vector<component> components;
+        DenseMap<const Function*, unsigned> component_of;
+        for(scc_iterator<CallGraph*> it = scc_begin(&graph); !it.isAtEnd(); ++it){
+          component current;
+          current.recursive = it.hasCycle();
+          for(CallGraphNode* node : *it){
+            Function* F = node->getFunction();
+            if(F && !F->isDeclaration()){
+              current.functions.push_back(F);
+            }
+          }
+          if(current.functions.empty()){
+            continue;
+          }
+          for(Function* F : current.functions){
+            component_of[F] = components.size();
+            summaries[F] = pointsToSummary();
+          }
+          components.push_back(std::move(current));
+        }
+        // Components come callees first; callers wait for the ones they call
+        for(unsigned idx = 0; idx < components.size(); idx++){
+          DenseSet<unsigned> callees;
+          for(Function* F : components[idx].functions){
+            for(auto& record : *graph[F]){
+              Function* callee = record.second->getFunction();
+              auto it = callee ? component_of.find(callee) : component_of.end();
+              if(it != component_of.end() && it->second != idx && callees.insert(it->second).second){
+                components[it->second].callers.push_back(idx);
+                components[idx].waiting++;
+              }
+            }
+          }
+        }
+        unsigned thread_count = hardware_concurrency(threads).compute_thread_count();
+        if(thread_count <= 1 || components.size() <= 1){
+          for(component& current : components){
+            solve_component(current);
+          }
+          return;
+        }
+        ThreadPool pool(hardware_concurrency(threads));
+        std::mutex mutex;
+        std::function<void(unsigned)> schedule = [&](unsigned idx){
+          pool.async([&, idx](){
+            in_parallel_worker() = true;
+            solve_component(components[idx]);
+            std::lock_guard<std::mutex> lock(mutex);
+            for(unsigned caller : components[idx].callers){
+              if(--components[caller].waiting == 0){
+                schedule(caller);
+              }
+            }
+          });
+        };
+        for(unsigned idx = 0; idx < components.size(); idx++){
+          if(components[idx].waiting == 0){
+            schedule(idx);
+          }
+        }
+        pool.wait();
+      }
+
+      // The fixed point of F under the summaries of its callees
+      blockState<valueType> solve(mayPoint& solver, Function& F){
+        solver.strategy = strategy;
+        blockState<valueType> state = solver.initial_state(solver.bottom());
+        solver.run_dataflow(F, state);
+        solved++;
+        return state;
+      }
+
+    private:
+      struct component{
+        std::vector<Function*> functions;
+        bool recursive = false;
+        std::vector<unsigned> callers;
+        unsigned waiting = 0;
+      };
+
+      Module& M;
+      solverStrategy strategy;
+      precisionBudget budget;
+      resultCache* cache;
+
+      // Entries of summaries are all created before solving starts, so
+      // components solved concurrently only write the values of their own
+      pointsToSummary summarize_function(Function& F){
+        mayPoint solver(F, budget, &summaries);
+        blockState<valueType> state = solve(solver, F);
+        return summarize(F, solver.context, state);
+      }
+
+      void solve_component(component& current){
+        if(!current.recursive){
+          Function* F = current.functions[0];
+          summaries.find(F)->second = cached_summary(*F);
+          return;
+        }
+        bool changed = true;
+        while(changed){
+          changed = false;
+          for(Function* F : current.functions){
+            changed |= summaries.find(F)->second.join(summarize_function(*F));
+          }
+        }
+      }
+
+      pointsToSummary cached_summary(Function& F){
+        std::string tag = cache ? budget_cache_tag("maypoint-summary", budget) : "";
+        if(!tag.empty()){
+          tag = summary_cache_tag(F, summaries, tag);
+        }
+        if(tag.empty()){
+          return summarize_function(F);
+        }
+        phaseTimer lookup_timer("cache", "Look up and fill the result cache");
+        functionFingerprint fingerprint(F, tag);
+        std::string payload;
+        pointsToSummary summary;
+        if(cache->lookup(fingerprint.key, payload)){
+          cacheReader reader(payload);
+          if(decode_summary(reader, fingerprint, M, summary)){
+            cached++;
+            return summary;
+          }
+          summary = pointsToSummary();
+        }
+        lookup_timer.stop();
+        summary = summarize_function(F);
+        phaseTimer store_timer("cache", "Look up and fill the result cache");
+        cacheWriter writer;
+        if(encode_summary(writer, fingerprint, summary)){
+          cache->store(fingerprint.key, writer.bytes);
+        }
+        return summary;
+      }
+  };
+
+  // Prints summary as "key : targets" lines under a heading, keys being the
+  // arguments and globals written, "return", "<local>" for what storage
+  // allocated by the function holds and "<unknown>" for what it wrote
+  // through unknown pointers
+  inline void print_summary(resultEmitter& emitter, Function& F, const pointsToSummary& summary){
+    raw_ostream& out = emitter.out();
+    auto print_set = [&](const summarySet& set){
+      for(Value* target : set.targets){
+        emitter.operand(target, false);
+        out << ", ";
+      }
+      if(set.local){
+        out << "<local>, ";
+      }
+      if(set.unknown){
+        out << "<unknown>, ";
+      }
+      out << "\n";
+    };
+    out << "Points-to summary of " << F.getName() << "\n";
+    for(auto& store : summary.stores){
+      emitter.operand(store.first, false);
+      out << " : ";
+      print_set(store.second);
+    }
+    auto print_entry = [&](StringRef name, const summarySet& set){
+      if(!set.empty()){
+        out << name << " : ";
+        print_set(set);
+      }
+    };
+    print_entry("return", summary.returned);
+    print_entry("<local>", summary.locals);
+    print_entry("<unknown>", summary.anywhere);
+    out << "\n";
+    emitter.end_record();
+  }
+
+  inline void json_summary(resultEmitter& emitter, const pointsToSummary& summary){
+    emitter.json_record([&](json::OStream& record){
+      auto json_set = [&](StringRef key, const summarySet& set){
+        record.attributeArray(key, [&](){
+          for(Value* target : set.targets){
+            record.value(emitter.operand_name(target));
+          }
+          if(set.local){
+            record.value("<local>");
+          }
+          if(set.unknown){
+            record.value("<unknown>");
+          }
+        });
+      };
+      record.attributeObject("summary", [&](){
+        for(auto& store : summary.stores){
+          json_set(emitter.operand_name(store.first), store.second);
+        }
+        if(!summary.returned.empty()){
+          json_set("return", summary.returned);
+        }
+        if(!summary.locals.empty()){
+          json_set("<local>", summary.locals);
+        }
+        if(!summary.anywhere.empty()){
+          json_set("<unknown>", summary.anywhere);
+        }
+      });
+    });
+  }
+}
+
+#endif
@@ -2,202 +2,255 @@
 #include "llvm/ADT/Statistic.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
 #include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/IR/CFG.h" // For iterating over predecessors of a basic block
 #include "llvm/IR/InstIterator.h"
 #include "llvm/Analysis/Dataflow.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/PassPlugin.h"
+#include "Maypoint.h"
+#include "Andersen.h"
+#include "MaypointAnalysis.h"
 #include <map>
 #include <set>
 
 using namespace llvm;
+using namespace maypoint;
 
 #define DEBUG_TYPE "reaching"
 
+static cl::opt<solverStrategy> MaypointSolver("maypoint-solver",
+    cl::desc("Fixed-point strategy for the Maypoint pass"),
+    cl::init(WORKLIST), solverStrategyValues());
+static cl::opt<unsigned> MaypointThreads("maypoint-threads",
+    cl::desc("Threads used by -Maypoint-parallel and -Maypoint-interprocedural (0 = all hardware threads)"),
+    cl::init(0));
+static cl::opt<outputMode> MaypointOutput("maypoint-output",
+    cl::desc("What the Maypoint pass prints"),
+    cl::init(FULL_OUTPUT), outputModeValues());
+static cl::opt<std::string> MaypointCacheDir("maypoint-cache-dir",
+    cl::desc("Directory of an on-disk cache of Maypoint fixed points, keyed by function structure (flow-sensitive mode only)"),
+    cl::value_desc("directory"));
+static cl::opt<unsigned> MaypointCacheSize("maypoint-cache-size",
+    cl::desc("Size cap of -maypoint-cache-dir in MiB; the least recently used entries are evicted"),
+    cl::init(256));
+
+static cl::opt<unsigned> MaypointMaxSetSize("maypoint-max-set-size",
+    cl::desc("Collapse points-to sets with more elements to unknown (0 = no limit)"),
+    cl::init(0));
+static cl::opt<unsigned> MaypointMaxLatticeSize("maypoint-max-lattice-size",
+    cl::desc("MiB of points-to sets and maps per function after which new sets collapse to unknown (0 = no limit)"),
+    cl::init(0));
+static cl::opt<unsigned> MaypointMaxEvaluations("maypoint-max-evaluations",
+    cl::desc("Block evaluations per function after which new sets collapse to unknown (0 = no limit)"),
+    cl::init(0));
+static cl::opt<unsigned> MaypointTimeBudget("maypoint-time-budget",
+    cl::desc("Milliseconds of solving per function after which new sets collapse to unknown (0 = no limit)"),
+    cl::init(0));
+
+static cl::opt<maypointMode> MaypointMode("maypoint-mode",
+    cl::desc("Precision of the Maypoint pass"),
+    cl::init(FLOW_SENSITIVE),
+    cl::values(clEnumValN(FLOW_SENSITIVE, "flow-sensitive", "A points-to map at every instruction"),
+               clEnumValN(ANDERSEN, "andersen", "One points-to set per value for the whole function")));
+
 
 
 namespace {
-  class valueType : public std::map<Value*,std::set<Value*>>{
-    public:
-      valueType(){}
-      valueType(Function& F){
-        std::set<Value*> empty;
-        for(auto arg = F.arg_begin(); arg != F.arg_end(); ++arg){
-          (*this)[(Value*)&*arg] = empty;
-        }
-        for(inst_iterator I = inst_begin(F); I != inst_end(F); ++I){
-          (*this)[(Value *)&*I] = empty;
-        }
+  precisionBudget budgetOptions(){
+    precisionBudget budget;
+    budget.max_set_size = MaypointMaxSetSize;
+    budget.max_lattice_bytes = (uint64_t)MaypointMaxLatticeSize << 20;
+    budget.max_evaluations = MaypointMaxEvaluations;
+    budget.max_milliseconds = MaypointTimeBudget;
+    return budget;
+  }
+
+  struct Maypoint : public FunctionPass {
+    static char ID; // Pass identification, replacement for typeid
+    Maypoint() : FunctionPass(ID) {}
+    // Runs the analysis on F and prints the result to OS
+    static void analyzeFunction(Function &F, raw_ostream &OS){
+      MayPointInfo info(F, MaypointMode, MaypointSolver, getMaypointResultCache(), budgetOptions());
+      printResults(info, F, OS);
+    }
+
+    // Prints info, the result of the analysis on F, as chosen by
+    // -maypoint-output
+    static void printResults(MayPointInfo& info, Function &F, raw_ostream &OS){
+      if(!info.flow_sensitive()){
+        printFlowInsensitive(info, F, OS);
+        return;
       }
-      void init(Function& F){
-        std::set<Value*> empty;
-        for(auto arg = F.arg_begin(); arg != F.arg_end(); ++arg){
-          (*this)[(Value*)&*arg] = empty;
-        }
-        for(inst_iterator I = inst_begin(F); I != inst_end(F); ++I){
-          (*this)[(Value *)&*I] = empty;
-        }
+      resultEmitter emitter(F, OS, MaypointOutput);
+      phaseTimer print_timer("print", "Print results");
+      if(emitter.mode == SUMMARY_OUTPUT){
+        emit_block_summaries(emitter, F, info.fixed_point());
+        return;
       }
-      valueType operator ^ (valueType a){
-        valueType result(a);
-        for(auto it = this->begin(); it != this->end(); ++it){
-          if(result.find(it->first) == result.end()){
-            result[it->first] = it->second;
-          }else{
-            result[it->first].insert(it->second.begin(),it->second.end());
-          }
-        }
-        return result;
+      instructionQuery<valueType>& query = info.instructions();
+      if(emitter.mode == JSON_OUTPUT){
+        emit_json(emitter, F, query);
+        return;
       }
-  };
-
-  class mayPoint : public dataFlow<valueType>{
-    public:
-      mayPoint(Function& F){
-        top.init(F);
-        is_forward = true;
-        construct_transfer_function_objects(F);
+      if(emitter.mode == NO_OUTPUT){
+        return;
       }
-
-      std::map<Instruction*, valueType> propagateToInstructions(Function& F, std::map<std::pair<BasicBlock*,bool>,valueType> bb_fixed_point){
-        std::map<Instruction*, valueType> inst_fixed_point;
-        for(auto&& bb : F.getBasicBlockList()){
-          valueType current = bb_fixed_point[std::make_pair(&bb, true)];
-          for(auto inst = bb.begin(); inst != bb.end(); ++inst){
-            current = instructionTransferFunction(&*inst, current);
-            inst_fixed_point[&*inst] = current;
-          }
+      raw_ostream& out = emitter.out();
+      for(auto&& bb : F.getBasicBlockList()){
+        emitter.operand(&bb);
+        out << ":\n";
+        for(auto inst = bb.begin(); inst != bb.end(); ++inst){
+          emitter.instruction(*inst);
+          out << "\n";
+          print_lattice(emitter, query.valueAt(&*inst));
         }
-        return inst_fixed_point;
+        out << "\n\n";
+        emitter.end_record();
       }
-    private:
-      valueType instructionTransferFunction(Instruction* inst, valueType in){
-        valueType result(in);
-        std::set<Value*> points_to_set(in[(Value *)inst]);
-        if(isa<AllocaInst>(inst)){
-          points_to_set.insert((Value *)inst);
-          result[(Value *)inst] = points_to_set;
-          return result;
-        }
-        if(isa<BitCastInst>(inst)){
-          BitCastInst* bit_cast_inst = dyn_cast<BitCastInst>(inst);
-          Type* src_type = bit_cast_inst->getSrcTy();
-          Type* dest_type = bit_cast_inst->getDestTy();
-          if(isa<PointerType>(src_type) && isa<PointerType>(dest_type)){
-            Value* used = bit_cast_inst->getOperand(0);
-            std::set<Value*> used_points_to = in[used];
-            result[(Value *)inst].insert(used_points_to.begin(),used_points_to.end());
-          }
-          return result;
-        }
-        if(isa<GetElementPtrInst>(inst)){
-          GetElementPtrInst* get_elem_ptr_inst = dyn_cast<GetElementPtrInst>(inst);
-          result[(Value*)inst].insert(get_elem_ptr_inst->getPointerOperand());
-          return result;
-        }
-        if(isa<LoadInst>(inst)){
-          if(!inst->getType()->isPointerTy()){
-            return result;
-          }
-          Value* pointer_to_be_loaded = inst->getOperand(0);
-          std::set<Value*> pointers_which_may_be_pointed_to = result[pointer_to_be_loaded];
-          for(auto& pointer_which_may_be_pointed_to : pointers_which_may_be_pointed_to){
-            result[(Value*)inst].insert(result[&*pointer_which_may_be_pointed_to].begin(),result[&*pointer_which_may_be_pointed_to].end());
-          }
-          return result;
-        }
-        if(isa<StoreInst>(inst)){
-          StoreInst* store_inst = dyn_cast<StoreInst>(inst);
-          if(!store_inst->getValueOperand()->getType()->isPointerTy()){
-            return result;
-          }
-          std::set<Value*> value_operand_points_to = result[store_inst->getValueOperand()];
-          std::set<Value*> pointer_operand_points_to = result[store_inst->getPointerOperand()];
-          for(auto& it1 : pointer_operand_points_to){
-            result[&*it1].insert(value_operand_points_to.begin(),value_operand_points_to.end());
-          }
-          return result;
-        }
-        if(isa<SelectInst>(inst)){
-          if(!inst->getType()->isPointerTy()){
-            return result;
-          }
-          SelectInst* select_inst = dyn_cast<SelectInst>(inst);
-          std::set<Value*> true_pointer_points_to = result[select_inst->getTrueValue()];
-          std::set<Value*> false_pointer_points_to = result[select_inst->getFalseValue()];
-          result[(Value*)inst].insert(true_pointer_points_to.begin(),true_pointer_points_to.end());
-          result[(Value*)inst].insert(false_pointer_points_to.begin(),false_pointer_points_to.end());
-          return result;
-        }
-        if(isa<PHINode>(inst)){
-          if(!inst->getType()->isPointerTy())
-            return result;
-          for(const Use& u: inst->operands()){
-            result[(Value*)inst].insert(result[u.get()].begin(),result[u.get()].end());
-          }
-          return result;
-        }
-        return result;
+    }
+
+    // Andersen-style mode: the points-to sets hold at every instruction, so
+    // they are printed once per function
+    static void printFlowInsensitive(MayPointInfo& info, Function &F, raw_ostream &OS){
+      resultEmitter emitter(F, OS, MaypointOutput);
+      const valueType& result = info.flow_insensitive_map();
+      phaseTimer print_timer("print", "Print results");
+      if(emitter.mode == NO_OUTPUT){
+        return;
       }
-      void construct_transfer_function_objects(Function& F){
-        for(auto&& bb : F.getBasicBlockList()){
-          transferFunction<valueType> tf;
-          BasicBlock* bb_pointer = &bb;
-          tf.basic_block = bb_pointer;
-          tf.is_forward = true;
-          tf.blockToTransferFunctionsMap = &allTransferFunctions;
-          tf.blockTransferFunction = [this,bb_pointer](valueType in){
-            valueType out(in);
-            for(auto inst = bb_pointer->begin(); inst != bb_pointer->end(); ++inst){
-              out = this->instructionTransferFunction(&*inst,out);
-            }
-            return out;
-          };
-          allTransferFunctions[bb_pointer] = tf;
-        }
+      if(emitter.mode == JSON_OUTPUT){
+        emitter.json_record([&](json::OStream& record){
+          json_lattice(emitter, record, result);
+        });
+        return;
       }
+      emitter.out() << "Flow-insensitive points-to sets of " << F.getName() << "\n";
+      print_lattice(emitter, result);
+      emitter.out() << "\n";
+      emitter.end_record();
+    }
+
+    bool runOnFunction(Function &F) override {
+      analyzeFunction(F, outs());
+      return false;
+    }
   };
 
+  // Module-level mode. Functions are independent for this intraprocedural
+  // analysis, so they are solved concurrently and their buffered output is
+  // emitted in module order.
+  struct MaypointParallel : public ModulePass {
+    static char ID;
+    MaypointParallel() : ModulePass(ID) {}
+    bool runOnModule(Module &M) override {
+      run_on_functions_in_parallel(M, MaypointThreads, Maypoint::analyzeFunction, outs());
+      return false;
+    }
+  };
 
-  struct Maypoint : public FunctionPass {
-    static char ID; // Pass identification, replacement for typeid
-    Maypoint() : FunctionPass(ID) {}
-    bool runOnFunction(Function &F) override {
-      mayPoint md(F);
-      std::map<std::pair<BasicBlock*, bool>, valueType> previous;
-      for(auto& bb : F.getBasicBlockList()){
-        valueType in;
-        valueType out;
-        previous[std::make_pair(&bb,true)] = in;
-        previous[std::make_pair(&bb,false)] = out;
+  // Interprocedural mode. Summaries are computed bottom-up over the call
+  // graph, then every function is solved once more with the summaries of its
+  // callees applied at calls, and printed followed by its own summary. Always
+  // flow-sensitive; -maypoint-mode does not apply.
+  struct MaypointInterprocedural : public ModulePass {
+    static char ID;
+    MaypointInterprocedural() : ModulePass(ID) {}
+
+    // Prints the result on F under summaries, then the summary of F
+    static void printWithSummary(const summaryTable& summaries, Function &F, raw_ostream &OS){
+      MayPointInfo info(F, FLOW_SENSITIVE, MaypointSolver, getMaypointResultCache(), budgetOptions(), &summaries);
+      Maypoint::printResults(info, F, OS);
+      resultEmitter emitter(F, OS, MaypointOutput);
+      if(emitter.mode == JSON_OUTPUT){
+        json_summary(emitter, summaries.lookup(&F));
       }
-      md.run_dataflow(F,previous);
-      std::map<Instruction*,valueType> instructionFixedPoint = md.propagateToInstructions(F,previous);
-      for(auto&& bb : F.getBasicBlockList()){
-        bb.printAsOperand(outs());
-        outs() << ":\n";
-        for(auto inst = bb.begin(); inst != bb.end(); ++inst){
-          inst->print(outs());
-          outs() << "\n";
-          outs() << "{\n";
-          valueType maypoint = instructionFixedPoint[&*inst];
-          for(auto it = maypoint.begin(); it != maypoint.end(); ++it){
-            if(it->second.size() == 0){
-              continue;
-            }
-            it->first->printAsOperand(outs(),false);
-            outs() << " : ";
-            std::for_each(it->second.begin(),it->second.end(),[](Value* x){x->printAsOperand(outs(),false); outs() << ", ";});
-            outs() <<"\n";
-          }
-          outs() << "}\n";
-        }
-        outs() << "\n\n";
+      else if(emitter.mode != NO_OUTPUT){
+        print_summary(emitter, F, summaries.lookup(&F));
       }
+    }
+
+    bool runOnModule(Module &M) override {
+      summarySolver solver(M, MaypointSolver, budgetOptions(), getMaypointResultCache());
+      solver.run(MaypointThreads);
+      const summaryTable& summaries = solver.summaries;
+      run_on_functions_in_parallel(M, MaypointThreads, [&summaries](Function &F, raw_ostream &OS){
+        printWithSummary(summaries, F, OS);
+      }, outs());
       return false;
     }
   };
 }
 
 char Maypoint::ID = 0;
-static RegisterPass<Maypoint> X("Maypoint", "May point to analysis pass");
\ No newline at end of file
+static RegisterPass<Maypoint> X("Maypoint", "May point to analysis pass");
+char MaypointParallel::ID = 0;
+static RegisterPass<MaypointParallel> Y("Maypoint-parallel", "May point to analysis pass, all functions in parallel");
+char MaypointInterprocedural::ID = 0;
+static RegisterPass<MaypointInterprocedural> Z("Maypoint-interprocedural", "May point to analysis pass, with summaries of the callees applied at calls");
+
+resultCache* getMaypointResultCache(){
+  static std::unique_ptr<resultCache> cache = MaypointCacheDir.empty() ? nullptr : std::unique_ptr<resultCache>(new resultCache(MaypointCacheDir, (uint64_t)MaypointCacheSize << 20));
+  return cache.get();
+}
+
+AnalysisKey MayPointAnalysis::Key;
+AnalysisKey MayPointSummaryAnalysis::Key;
+
+PreservedAnalyses MayPointPrinterPass::run(Function &F, FunctionAnalysisManager &FAM){
+  Maypoint::printResults(FAM.getResult<MayPointAnalysis>(F), F, OS);
+  return PreservedAnalyses::all();
+}
+
+PreservedAnalyses MayPointInterproceduralPrinterPass::run(Module &M, ModuleAnalysisManager &MAM){
+  const summaryTable& summaries = MAM.getResult<MayPointSummaryAnalysis>(M).summaries;
+  for(Function &F : M){
+    if(!F.isDeclaration()){
+      MaypointInterprocedural::printWithSummary(summaries, F, OS);
+    }
+  }
+  return PreservedAnalyses::all();
+}
+
+// New pass manager: the options of the legacy pass configure the analyses,
+// and require<maypoint> or invalidate<maypoint> name the function analysis
+// in a pipeline, require<maypoint-summaries> the module one
+PassPluginLibraryInfo getMaypointPluginInfo(){
+  return {LLVM_PLUGIN_API_VERSION, "Maypoint", LLVM_VERSION_STRING, [](PassBuilder &PB){
+    PB.registerAnalysisRegistrationCallback([](FunctionAnalysisManager &FAM){
+      FAM.registerPass([](){
+        return MayPointAnalysis(MaypointMode, MaypointSolver, getMaypointResultCache(), budgetOptions());
+      });
+    });
+    PB.registerAnalysisRegistrationCallback([](ModuleAnalysisManager &MAM){
+      MAM.registerPass([](){
+        return MayPointSummaryAnalysis(MaypointSolver, budgetOptions(), getMaypointResultCache(), MaypointThreads);
+      });
+    });
+    PB.registerPipelineParsingCallback([](StringRef Name, FunctionPassManager &FPM, ArrayRef<PassBuilder::PipelineElement>){
+      if(Name == "print<maypoint>"){
+        FPM.addPass(MayPointPrinterPass(outs()));
+        return true;
+      }
+      return parseAnalysisUtilityPasses<MayPointAnalysis>("maypoint", Name, FPM);
+    });
+    PB.registerPipelineParsingCallback([](StringRef Name, ModulePassManager &MPM, ArrayRef<PassBuilder::PipelineElement>){
+      if(Name == "print<maypoint-interprocedural>"){
+        MPM.addPass(MayPointInterproceduralPrinterPass(outs()));
+        return true;
+      }
+      return parseAnalysisUtilityPasses<MayPointSummaryAnalysis>("maypoint-summaries", Name, MPM);
+    });
+  }};
+}
+
+// Tools linking the pass in statically register it through
+// getMaypointPluginInfo instead
+#ifndef LLVM_MAYPOINT_LINK_INTO_TOOLS
+extern "C" LLVM_ATTRIBUTE_WEAK PassPluginLibraryInfo llvmGetPassPluginInfo(){
+  return getMaypointPluginInfo();
+}
+#endif
@@ -0,0 +1,817 @@
+// ===- Maypoint.h May point-to solver, shared by the pass and the tools ---===//
+#ifndef DATAFLOW_MAYPOINT_H
+#define DATAFLOW_MAYPOINT_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/IntrusiveRefCntPtr.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/Analysis/Dataflow.h"
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <set>
+
+namespace maypoint {
+  // Interned points-to set: the sorted numbers of its elements, stored once per
+  // distinct set so that equal sets are the same pointer. nullptr is the empty
+  // set.
+  typedef const ArrayRef<unsigned>* pointsToSet;
+
+  // The set a points-to set collapses to when it exceeds the precision budget:
+  // it may point to anything, and absorbs every union. It has no elements to
+  // iterate, so code reading elements must test for it first.
+  inline pointsToSet unknownSet(){
+    static const ArrayRef<unsigned> any;
+    return &any;
+  }
+
+  // Bounds on the precision of one Maypoint run; 0 means no bound. A set that
+  // would exceed max_set_size collapses to unknownSet(). Once the interned
+  // sets and map chunks take max_lattice_bytes, or the solver has evaluated
+  // max_evaluations blocks or run for max_milliseconds, every set not seen
+  // before collapses, so the fixed point is reached quickly and conservatively.
+  struct precisionBudget{
+    unsigned max_set_size = 0;
+    uint64_t max_lattice_bytes = 0;
+    uint64_t max_evaluations = 0;
+    unsigned max_milliseconds = 0;
+
+    bool bounded() const{
+      return max_set_size || max_lattice_bytes || max_evaluations || max_milliseconds;
+    }
+  };
+
+  // Analysis name under which results of a run with budget are cached, or ""
+  // if they must not be: a time budget makes them depend on the machine
+  inline std::string budget_cache_tag(StringRef analysis, const precisionBudget& budget){
+    if(budget.max_milliseconds){
+      return "";
+    }
+    std::string tag = analysis.str();
+    if(budget.bounded()){
+      tag += "-s" + utostr(budget.max_set_size) + "-b" + utostr(budget.max_lattice_bytes) + "-e" + utostr(budget.max_evaluations);
+    }
+    return tag;
+  }
+
+  // Part of a call's effect on the points-to map of its caller. A target is
+  // an argument of the callee, standing for what the caller passes in it, a
+  // global or other constant; local stands for storage allocated by the
+  // callee or its callees, named after the call in the caller.
+  struct summarySet{
+    std::vector<Value*> targets; // Sorted by address
+    bool local = false;
+    bool unknown = false;
+
+    bool empty() const{
+      return targets.empty() && !local && !unknown;
+    }
+
+    bool operator==(const summarySet& other) const{
+      return targets == other.targets && local == other.local && unknown == other.unknown;
+    }
+
+    // Adds the targets of other, reporting whether any was new
+    bool join(const summarySet& other){
+      bool changed = (other.local && !local) || (other.unknown && !unknown);
+      local |= other.local;
+      unknown |= other.unknown;
+      std::vector<Value*> merged;
+      std::set_union(targets.begin(), targets.end(), other.targets.begin(), other.targets.end(), std::back_inserter(merged));
+      changed |= merged.size() != targets.size();
+      targets = std::move(merged);
+      return changed;
+    }
+  };
+
+  // What a call to a function may change in its caller's map: the set added
+  // to what each pointer argument points to and to each global (stores, by
+  // argument or global, sorted by address), what the returned pointer may
+  // point to, what the storage it allocates may hold and what it may have
+  // written through unknown pointers
+  struct pointsToSummary{
+    std::vector<std::pair<Value*, summarySet>> stores;
+    summarySet returned;
+    summarySet locals;
+    summarySet anywhere;
+
+    bool operator==(const pointsToSummary& other) const{
+      return stores == other.stores && returned == other.returned && locals == other.locals && anywhere == other.anywhere;
+    }
+
+    bool join(const pointsToSummary& other){
+      bool changed = returned.join(other.returned);
+      changed |= locals.join(other.locals);
+      changed |= anywhere.join(other.anywhere);
+      for(auto& store : other.stores){
+        auto pos = std::lower_bound(stores.begin(), stores.end(), store.first, [](const std::pair<Value*, summarySet>& entry, Value* key){
+          return entry.first < key;
+        });
+        if(pos == stores.end() || pos->first != store.first){
+          stores.insert(pos, store);
+          changed = true;
+        }
+        else{
+          changed |= pos->second.join(store.second);
+        }
+      }
+      return changed;
+    }
+  };
+
+  typedef DenseMap<const Function*, pointsToSummary> summaryTable;
+
+  // Adds the collapses of one run to the statistics printed by -stats
+  inline void record_collapse_statistics(uint64_t collapsed_sets, bool exhausted){
+    static Statistic NumCollapsedSets = {"dataflow", "NumCollapsedSets", "Points-to sets collapsed to unknown by the precision budget"};
+    static Statistic NumBudgetExhausted = {"dataflow", "NumBudgetExhausted", "Maypoint runs whose lattice size, evaluation or time budget ran out"};
+    NumCollapsedSets += collapsed_sets;
+    if(exhausted){
+      ++NumBudgetExhausted;
+    }
+  }
+
+  // Storage shared by the lattice values of one Maypoint run: the numbering of
+  // pointer values, the interned sets and the chunks of the persistent maps.
+  // Sets and chunks live in the arena of the run.
+  class pointsToContext{
+    public:
+      static const unsigned chunk_size = 32;
+
+      // Entries of a map for value numbers [k * chunk_size, (k + 1) * chunk_size),
+      // shared between maps until one of them writes to it. A chunk no longer
+      // referenced goes to a free list kept in the arena, so that it can be
+      // released in any order relative to the context.
+      struct chunk{
+        chunk** free_list;
+        chunk* next_free;
+        unsigned refs;
+        pointsToSet entries[chunk_size];
+
+        void Retain(){
+          refs++;
+        }
+
+        void Release(){
+          if(--refs == 0){
+            next_free = *free_list;
+            *free_list = this;
+          }
+        }
+      };
+
+      valueNumbering numbering; // Arguments and instructions, then other values as met
+      precisionBudget budget;
+      // Summaries applied at calls in the interprocedural mode; without them
+      // calls have no effect
+      const summaryTable* summaries = nullptr;
+      uint64_t collapsed_sets = 0;
+      bool exhausted = false; // A budget other than max_set_size ran out
+
+      explicit pointsToContext(latticeArena& arena) : arena(arena) {
+        free_list = new (arena.allocate(sizeof(chunk*), alignof(chunk*))) chunk*(nullptr);
+      }
+
+      ~pointsToContext(){
+        if(budget.bounded()){
+          record_collapse_statistics(collapsed_sets, exhausted);
+        }
+      }
+
+      // Called before each solve, so that an update of a previous result gets
+      // the evaluation and time budgets afresh. The lattice size budget is
+      // not restarted: the sets interned so far are still held.
+      void restart_budget(){
+        if(exhausted){
+          record_collapse_statistics(0, true);
+        }
+        exhausted = budget.max_lattice_bytes && lattice_bytes > budget.max_lattice_bytes;
+        evaluations = 0;
+      }
+
+      // Called by the solver before each block evaluation, to charge the
+      // evaluation and time budgets
+      void charge_evaluation(){
+        if(exhausted || (!budget.max_evaluations && !budget.max_milliseconds)){
+          return;
+        }
+        if(evaluations++ == 0){
+          start = std::chrono::steady_clock::now();
+        }
+        if(budget.max_evaluations && evaluations > budget.max_evaluations){
+          exhausted = true;
+        }
+        check_clock();
+      }
+
+      // Also called every few instructions of a long block, where a single
+      // evaluation can take seconds
+      void check_clock(){
+        if(!exhausted && budget.max_milliseconds && std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(budget.max_milliseconds)){
+          exhausted = true;
+        }
+      }
+
+      pointsToSet intern(ArrayRef<unsigned> sorted){
+        if(sorted.empty()){
+          return nullptr;
+        }
+        auto it = sets.find(sorted);
+        if(it != sets.end()){
+          return it->second;
+        }
+        if(exhausted || (budget.max_set_size && sorted.size() > budget.max_set_size)){
+          collapsed_sets++;
+          return unknownSet();
+        }
+        if(budget.max_lattice_bytes && (lattice_bytes += sorted.size() * sizeof(unsigned) + sizeof(ArrayRef<unsigned>)) > budget.max_lattice_bytes){
+          exhausted = true;
+          collapsed_sets++;
+          return unknownSet();
+        }
+        unsigned* elements = static_cast<unsigned*>(arena.allocate(sorted.size() * sizeof(unsigned), alignof(unsigned)));
+        std::copy(sorted.begin(), sorted.end(), elements);
+        pointsToSet set = new (arena.allocate(sizeof(ArrayRef<unsigned>), alignof(ArrayRef<unsigned>))) ArrayRef<unsigned>(elements, sorted.size());
+        sets[*set] = set;
+        return set;
+      }
+
+      pointsToSet insert(pointsToSet set, unsigned element){
+        if(!set){
+          return intern(element);
+        }
+        if(set == unknownSet()){
+          return set;
+        }
+        auto pos = std::lower_bound(set->begin(), set->end(), element);
+        if(pos != set->end() && *pos == element){
+          return set;
+        }
+        scratch.assign(set->begin(), pos);
+        scratch.push_back(element);
+        scratch.append(pos, set->end());
+        return intern(scratch);
+      }
+
+      // Unions are memoized; the same pairs recur on every solver iteration
+      pointsToSet unite(pointsToSet a, pointsToSet b){
+        if(a == b || !b){
+          return a;
+        }
+        if(!a){
+          return b;
+        }
+        if(a == unknownSet() || b == unknownSet()){
+          return unknownSet();
+        }
+        std::pair<pointsToSet, pointsToSet> key = a < b ? std::make_pair(a, b) : std::make_pair(b, a);
+        auto it = unions.find(key);
+        if(it != unions.end()){
+          return it->second;
+        }
+        scratch.clear();
+        std::set_union(a->begin(), a->end(), b->begin(), b->end(), std::back_inserter(scratch));
+        pointsToSet result = scratch.size() == a->size() ? a : scratch.size() == b->size() ? b : intern(scratch);
+        unions[key] = result;
+        return result;
+      }
+
+      chunk* new_chunk(const chunk* copy_of){
+        chunk* result = *free_list;
+        if(result){
+          *free_list = result->next_free;
+        }
+        else{
+          result = static_cast<chunk*>(arena.allocate(sizeof(chunk), alignof(chunk)));
+          lattice_bytes += sizeof(chunk);
+        }
+        result->free_list = free_list;
+        result->refs = 0;
+        if(copy_of){
+          std::copy(copy_of->entries, copy_of->entries + chunk_size, result->entries);
+        }
+        else{
+          std::fill(result->entries, result->entries + chunk_size, nullptr);
+        }
+        return result;
+      }
+
+    private:
+      latticeArena& arena;
+      chunk** free_list;
+      DenseMap<ArrayRef<unsigned>, pointsToSet> sets;
+      DenseMap<std::pair<pointsToSet, pointsToSet>, pointsToSet> unions;
+      SmallVector<unsigned, 32> scratch;
+      uint64_t lattice_bytes = 0;
+      uint64_t evaluations = 0;
+      std::chrono::steady_clock::time_point start;
+  };
+
+  // Persistent map from value to points-to set. Copies share chunks and a
+  // chunk is copied on its first write, so a copy costs one pointer per chunk
+  // and an instruction changing one entry copies one chunk. Empty entries and
+  // chunks are not stored. A default constructed map is empty and takes its
+  // context from the first map joined into it.
+  class valueType{
+    public:
+      pointsToContext* context;
+      // What stores through an unknown pointer may have written to any
+      // location; loads read it in addition to the locations they name
+      pointsToSet anywhere = nullptr;
+
+      valueType() : context(nullptr) {}
+      explicit valueType(pointsToContext* context) : context(context) {}
+
+      pointsToSet get(unsigned idx) const{
+        unsigned chunk_idx = idx / pointsToContext::chunk_size;
+        if(chunk_idx >= chunks.size() || !chunks[chunk_idx]){
+          return nullptr;
+        }
+        return chunks[chunk_idx]->entries[idx % pointsToContext::chunk_size];
+      }
+
+      pointsToSet get(Value* v) const{
+        return get(context->numbering.number(v));
+      }
+
+      void set(unsigned idx, pointsToSet points_to){
+        if(get(idx) != points_to){
+          writable(idx / pointsToContext::chunk_size)->entries[idx % pointsToContext::chunk_size] = points_to;
+        }
+      }
+
+      // Calls f(value number, set) for the non-empty entries in number order
+      template<typename Fn>
+      void for_each(Fn f) const{
+        for(unsigned chunk_idx = 0; chunk_idx < chunks.size(); chunk_idx++){
+          if(!chunks[chunk_idx]){
+            continue;
+          }
+          for(unsigned pos = 0; pos < pointsToContext::chunk_size; pos++){
+            if(pointsToSet points_to = chunks[chunk_idx]->entries[pos]){
+              f(chunk_idx * pointsToContext::chunk_size + pos, points_to);
+            }
+          }
+        }
+      }
+
+      // Unions every points-to set of src into this map, reporting whether any
+      // set grew. Chunks shared with src are skipped without looking inside.
+      bool join(const valueType& src){
+        if(!context){
+          context = src.context;
+        }
+        bool changed = false;
+        pointsToSet merged_anywhere = context->unite(anywhere, src.anywhere);
+        if(merged_anywhere != anywhere){
+          anywhere = merged_anywhere;
+          changed = true;
+        }
+        for(unsigned chunk_idx = 0; chunk_idx < src.chunks.size(); chunk_idx++){
+          const pointsToContext::chunk* from = src.chunks[chunk_idx].get();
+          if(!from || (chunk_idx < chunks.size() && chunks[chunk_idx].get() == from)){
+            continue;
+          }
+          if(chunk_idx >= chunks.size() || !chunks[chunk_idx]){
+            if(chunk_idx >= chunks.size()){
+              chunks.resize(chunk_idx + 1);
+            }
+            chunks[chunk_idx] = const_cast<pointsToContext::chunk*>(from);
+            changed = true;
+            continue;
+          }
+          for(unsigned pos = 0; pos < pointsToContext::chunk_size; pos++){
+            pointsToSet current = chunks[chunk_idx]->entries[pos];
+            pointsToSet merged = context->unite(current, from->entries[pos]);
+            if(merged != current){
+              writable(chunk_idx)->entries[pos] = merged;
+              changed = true;
+            }
+          }
+        }
+        return changed;
+      }
+
+    private:
+      std::vector<IntrusiveRefCntPtr<pointsToContext::chunk>> chunks;
+
+      pointsToContext::chunk* writable(unsigned chunk_idx){
+        if(chunk_idx >= chunks.size()){
+          chunks.resize(chunk_idx + 1);
+        }
+        IntrusiveRefCntPtr<pointsToContext::chunk>& slot = chunks[chunk_idx];
+        if(!slot || slot->refs > 1){
+          slot = context->new_chunk(slot.get());
+        }
+        return slot.get();
+      }
+  };
+
+  inline bool joinInto(valueType& dst, const valueType& src){
+    return dst.join(src);
+  }
+
+  // Number of points-to edges, for statistics
+  inline unsigned lattice_size(const valueType& value){
+    unsigned size = 0;
+    auto add = [&](pointsToSet points_to){
+      size += points_to == unknownSet() ? 1 : points_to->size();
+    };
+    value.for_each([&](unsigned idx, pointsToSet points_to){
+      add(points_to);
+    });
+    if(value.anywhere){
+      add(value.anywhere);
+    }
+    return size;
+  }
+
+  inline void print_points_to_set(resultEmitter& emitter, const valueType& value, pointsToSet points_to){
+    raw_ostream& out = emitter.out();
+    if(points_to == unknownSet()){
+      out << "<unknown>, ";
+      return;
+    }
+    for(unsigned x : *points_to){
+      emitter.operand(value.context->numbering.values[x], false);
+      out << ", ";
+    }
+  }
+
+  // Prints the non-empty points-to sets as "p : a, b, " lines between braces.
+  // A collapsed set prints as "<unknown>", and what may have been stored
+  // through unknown pointers as the set of "<unknown>".
+  inline void print_lattice(resultEmitter& emitter, const valueType& value){
+    raw_ostream& out = emitter.out();
+    out << "{\n";
+    value.for_each([&](unsigned idx, pointsToSet points_to){
+      emitter.operand(value.context->numbering.values[idx], false);
+      out << " : ";
+      print_points_to_set(emitter, value, points_to);
+      out << "\n";
+    });
+    if(value.anywhere){
+      out << "<unknown> : ";
+      print_points_to_set(emitter, value, value.anywhere);
+      out << "\n";
+    }
+    out << "}\n";
+  }
+
+  inline void json_points_to_set(resultEmitter& emitter, json::OStream& record, StringRef key, const valueType& value, pointsToSet points_to){
+    if(points_to == unknownSet()){
+      record.attributeArray(key, [&](){
+        record.value("<unknown>");
+      });
+      return;
+    }
+    SmallVector<Value*, 8> targets;
+    for(unsigned x : *points_to){
+      targets.push_back(value.context->numbering.values[x]);
+    }
+    emitter.json_value_set(record, key, targets);
+  }
+
+  inline void json_lattice(resultEmitter& emitter, json::OStream& record, const valueType& value){
+    record.attributeObject("points_to", [&](){
+      value.for_each([&](unsigned idx, pointsToSet points_to){
+        json_points_to_set(emitter, record, emitter.operand_name(value.context->numbering.values[idx]), value, points_to);
+      });
+      if(value.anywhere){
+        json_points_to_set(emitter, record, "<unknown>", value, value.anywhere);
+      }
+    });
+  }
+
+  // Cache codec: the number of entries, then the code of each pointer and
+  // its set of codes. Interned sets are written once per payload and referred
+  // back to after that. The code one past the fingerprint's values stands for
+  // the anywhere entry, and an empty set of codes for unknownSet().
+  inline bool encode_lattice(cacheWriter& writer, const functionFingerprint& fingerprint, const valueType& value){
+    SmallVector<std::pair<unsigned, pointsToSet>, 64> entries;
+    bool encodable = true;
+    value.for_each([&](unsigned idx, pointsToSet points_to){
+      unsigned code;
+      if(!fingerprint.code(value.context->numbering.values[idx], code)){
+        encodable = false;
+        return;
+      }
+      entries.push_back(std::make_pair(code, points_to));
+    });
+    if(!encodable){
+      return false;
+    }
+    if(value.anywhere){
+      entries.push_back(std::make_pair((unsigned)fingerprint.values.size(), value.anywhere));
+    }
+    writer.write(entries.size());
+    SmallVector<unsigned, 16> codes;
+    for(auto& entry : entries){
+      writer.write(entry.first);
+      if(writer.write_reference(entry.second)){
+        continue;
+      }
+      codes.clear();
+      if(entry.second == unknownSet()){
+        writer.write_codes(codes);
+        continue;
+      }
+      for(unsigned x : *entry.second){
+        unsigned element;
+        if(!fingerprint.code(value.context->numbering.values[x], element)){
+          return false;
+        }
+        codes.push_back(element);
+      }
+      writer.write_codes(codes);
+    }
+    return true;
+  }
+
+  // Fills value, which must be an empty map of the run
+  inline bool decode_lattice(cacheReader& reader, const functionFingerprint& fingerprint, valueType& value){
+    valueNumbering& numbering = value.context->numbering;
+    uint64_t count = reader.read();
+    SmallVector<unsigned, 16> codes;
+    for(uint64_t entry = 0; entry < count && !reader.failed; entry++){
+      uint64_t code = reader.read();
+      pointsToSet points_to = static_cast<pointsToSet>(reader.read_reference());
+      if(reader.failed || code > fingerprint.values.size()){
+        return false;
+      }
+      if(!points_to){
+        if(!reader.read_codes(codes, fingerprint.values.size())){
+          return false;
+        }
+        for(unsigned& element : codes){
+          element = numbering.number(fingerprint.values[element]);
+        }
+        llvm::sort(codes);
+        points_to = codes.empty() ? unknownSet() : value.context->intern(codes);
+        reader.add_reference(points_to);
+      }
+      if(code == fingerprint.values.size()){
+        value.anywhere = points_to;
+        continue;
+      }
+      value.set(numbering.number(fingerprint.values[code]), points_to);
+    }
+    return !reader.failed;
+  }
+
+  // Transfer policy: a block applies the effect of each of its instructions in
+  // order. Phi nodes read the merged IN, so there are no edge transfers.
+  class mayPointTransfer : public blockOnlyTransfer<valueType>{
+    public:
+      const blockNumbering* blocks;
+
+      void block(unsigned idx, const valueType& in, valueType& out) const{
+        BasicBlock* bb = blocks->blocks[idx];
+        out = in;
+        pointsToContext& context = *out.context;
+        context.charge_evaluation();
+        unsigned count = 0;
+        for(auto inst = bb->begin(); inst != bb->end(); ++inst){
+          instructionTransferFunction(&*inst, out);
+          if(++count % 64 == 0){
+            context.check_clock();
+          }
+        }
+      }
+
+    private:
+      // result[dest] = result[dest] U result[src]
+      static void unionInto(valueType& result, unsigned dest, unsigned src){
+        if(dest == src){
+          return;
+        }
+        result.set(dest, result.context->unite(result.get(dest), result.get(src)));
+      }
+
+      static void unionInto(valueType& result, Value* dest, Value* src){
+        valueNumbering& numbering = result.context->numbering;
+        unionInto(result, numbering.number(dest), numbering.number(src));
+      }
+
+      // Applies the summary of the callee of call. A call to a function
+      // without one, such as a declaration or an indirect call, is taken to
+      // return fresh storage named after the call and to change nothing else.
+      static void applyCall(CallBase* call, valueType& result){
+        pointsToContext& context = *result.context;
+        unsigned self = context.numbering.number(call);
+        Function* callee = call->getCalledFunction();
+        auto it = callee ? context.summaries->find(callee) : context.summaries->end();
+        if(it == context.summaries->end()){
+          if(call->getType()->isPointerTy()){
+            result.set(self, context.insert(result.get(self), self));
+          }
+          return;
+        }
+        const pointsToSummary& summary = it->second;
+        // Targets are bound to the sets before the call
+        valueType before = result;
+        auto bind = [&](const summarySet& set){
+          if(set.unknown){
+            return unknownSet();
+          }
+          pointsToSet bound = set.local ? context.insert(nullptr, self) : nullptr;
+          for(Value* target : set.targets){
+            if(Argument* formal = dyn_cast<Argument>(target)){
+              if(formal->getArgNo() < call->arg_size()){
+                bound = context.unite(bound, before.get(call->getArgOperand(formal->getArgNo())));
+              }
+            }
+            else{
+              bound = context.insert(bound, context.numbering.number(target));
+            }
+          }
+          return bound;
+        };
+        for(auto& store : summary.stores){
+          pointsToSet stored = bind(store.second);
+          if(!stored){
+            continue;
+          }
+          Argument* formal = dyn_cast<Argument>(store.first);
+          if(!formal){
+            unsigned global = context.numbering.number(store.first);
+            result.set(global, context.unite(result.get(global), stored));
+            continue;
+          }
+          if(formal->getArgNo() >= call->arg_size()){
+            continue;
+          }
+          pointsToSet locations = before.get(call->getArgOperand(formal->getArgNo()));
+          if(locations == unknownSet()){
+            result.anywhere = context.unite(result.anywhere, stored);
+          }
+          else if(locations){
+            for(unsigned location : *locations){
+              result.set(location, context.unite(result.get(location), stored));
+            }
+          }
+        }
+        result.anywhere = context.unite(result.anywhere, bind(summary.anywhere));
+        result.set(self, context.unite(result.get(self), bind(summary.locals)));
+        if(call->getType()->isPointerTy()){
+          result.set(self, context.unite(result.get(self), bind(summary.returned)));
+        }
+      }
+
+    public:
+      // Applies the effect of inst to state in place
+      static void instructionTransferFunction(Instruction* inst, valueType& result){
+        pointsToContext& context = *result.context;
+        if(isa<AllocaInst>(inst)){
+          unsigned self = context.numbering.number(inst);
+          result.set(self, context.insert(result.get(self), self));
+          return;
+        }
+        if(isa<BitCastInst>(inst)){
+          BitCastInst* bit_cast_inst = dyn_cast<BitCastInst>(inst);
+          Type* src_type = bit_cast_inst->getSrcTy();
+          Type* dest_type = bit_cast_inst->getDestTy();
+          if(isa<PointerType>(src_type) && isa<PointerType>(dest_type)){
+            unionInto(result, (Value *)inst, bit_cast_inst->getOperand(0));
+          }
+          return;
+        }
+        if(isa<GetElementPtrInst>(inst)){
+          GetElementPtrInst* get_elem_ptr_inst = dyn_cast<GetElementPtrInst>(inst);
+          unsigned self = context.numbering.number(inst);
+          result.set(self, context.insert(result.get(self), context.numbering.number(get_elem_ptr_inst->getPointerOperand())));
+          return;
+        }
+        if(isa<LoadInst>(inst)){
+          if(!inst->getType()->isPointerTy()){
+            return;
+          }
+          unsigned self = context.numbering.number(inst);
+          pointsToSet pointers_which_may_be_pointed_to = result.get(inst->getOperand(0));
+          if(pointers_which_may_be_pointed_to == unknownSet()){
+            result.set(self, unknownSet());
+            return;
+          }
+          if(pointers_which_may_be_pointed_to){
+            for(unsigned pointer_which_may_be_pointed_to : *pointers_which_may_be_pointed_to){
+              unionInto(result, self, pointer_which_may_be_pointed_to);
+            }
+            result.set(self, context.unite(result.get(self), result.anywhere));
+          }
+          return;
+        }
+        if(isa<StoreInst>(inst)){
+          StoreInst* store_inst = dyn_cast<StoreInst>(inst);
+          if(!store_inst->getValueOperand()->getType()->isPointerTy()){
+            return;
+          }
+          // Sets are immutable, so these stay as they were before the store
+          // even when a location points to itself or to the pointer operand
+          pointsToSet value_operand_points_to = result.get(store_inst->getValueOperand());
+          pointsToSet pointer_operand_points_to = result.get(store_inst->getPointerOperand());
+          if(value_operand_points_to && pointer_operand_points_to == unknownSet()){
+            result.anywhere = context.unite(result.anywhere, value_operand_points_to);
+            return;
+          }
+          if(value_operand_points_to && pointer_operand_points_to){
+            for(unsigned location : *pointer_operand_points_to){
+              result.set(location, context.unite(result.get(location), value_operand_points_to));
+            }
+          }
+          return;
+        }
+        if(isa<SelectInst>(inst)){
+          if(!inst->getType()->isPointerTy()){
+            return;
+          }
+          SelectInst* select_inst = dyn_cast<SelectInst>(inst);
+          unionInto(result, (Value*)inst, select_inst->getTrueValue());
+          unionInto(result, (Value*)inst, select_inst->getFalseValue());
+          return;
+        }
+        if(isa<PHINode>(inst)){
+          if(!inst->getType()->isPointerTy())
+            return;
+          for(const Use& u: inst->operands()){
+            unionInto(result, (Value*)inst, u.get());
+          }
+          return;
+        }
+        if(isa<CallBase>(inst)){
+          if(context.summaries){
+            applyCall(cast<CallBase>(inst), result);
+          }
+          return;
+        }
+      }
+  };
+
+  class mayPoint : public staticDataFlow<valueType, forwardDirection, mayPointTransfer>{
+    public:
+      pointsToContext context;
+
+      // With summaries, calls apply the summaries of their callees, and each
+      // pointer argument and global used by F starts out pointing to itself,
+      // standing for the storage the caller passes in or the global's own,
+      // so that effects on them can be read off the result.
+      mayPoint(Function& F, precisionBudget budget = precisionBudget(), const summaryTable* summaries = nullptr) : context(arena) {
+        context.budget = budget;
+        context.summaries = summaries;
+        context.numbering.init(F);
+        top = valueType(&context);
+        if(summaries){
+          for(Argument& arg : F.args()){
+            if(arg.getType()->isPointerTy()){
+              points_to_itself(&arg);
+            }
+          }
+          for(Instruction& inst : instructions(F)){
+            for(Value* operand : inst.operands()){
+              if(isa<GlobalVariable>(operand)){
+                points_to_itself(operand);
+              }
+            }
+          }
+        }
+        number_blocks(F);
+        transfer.blocks = &blocks;
+      }
+
+      // Empty map of this run, the initial state of every block
+      valueType bottom(){
+        return valueType(&context);
+      }
+
+      // Brings bb_fixed_point, the result before an edit of F, up to date.
+      // dirty lists the blocks whose instructions changed, including added
+      // blocks; the blocks they reach are solved again from the empty map.
+      void reanalyze(Function& F, blockState<valueType>& bb_fixed_point, ArrayRef<BasicBlock*> dirty){
+        context.restart_budget();
+        staticDataFlow::reanalyze(F, bb_fixed_point, dirty, bottom());
+      }
+
+      void run_dataflow(Function& F, blockState<valueType>& bb_fixed_point, const std::vector<bool>* seeds = nullptr){
+        context.restart_budget();
+        staticDataFlow::run_dataflow(F, bb_fixed_point, seeds);
+      }
+
+      // Points-to map after each instruction, computed on demand from the block
+      // fixed point
+      instructionQuery<valueType> makeInstructionQuery(blockState<valueType> bb_fixed_point){
+        return instructionQuery<valueType>(std::move(bb_fixed_point), true, true, mayPointTransfer::instructionTransferFunction);
+      }
+
+    private:
+      void points_to_itself(Value* v){
+        unsigned idx = context.numbering.number(v);
+        top.set(idx, context.insert(top.get(idx), idx));
+      }
+  };
+}
+
+#endif
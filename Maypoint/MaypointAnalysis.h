@@ -0,0 +1,244 @@
+// ===- MaypointAnalysis.h May point-to for the new pass manager ---===//
+#ifndef DATAFLOW_MAYPOINT_ANALYSIS_H
+#define DATAFLOW_MAYPOINT_ANALYSIS_H
+
+#include "llvm/IR/PassManager.h"
+#include "llvm/Passes/PassPlugin.h"
+#include "Maypoint.h"
+#include "Andersen.h"
+#include "Interprocedural.h"
+#include <memory>
+
+namespace maypoint {
+  enum maypointMode { FLOW_SENSITIVE, ANDERSEN };
+
+  // Result of MayPointAnalysis. Flow-sensitively it is the block fixed point
+  // of one function, with the map after each instruction replayed on demand;
+  // in Andersen mode it is the one map that holds everywhere. Either way the
+  // solver owning the context of the maps is kept alongside.
+  class MayPointInfo{
+    public:
+      // With a cache, a flow-sensitive fixed point stored for a function of
+      // the same structure is used instead of solving. budget bounds the
+      // flow-sensitive sets; results under a time budget are not cached, as
+      // they depend on the machine. With summaries, from summarySolver, calls
+      // apply the summaries of their callees.
+      MayPointInfo(Function &F, maypointMode mode = FLOW_SENSITIVE, solverStrategy strategy = WORKLIST, resultCache* cache = nullptr, precisionBudget budget = precisionBudget(), const summaryTable* summaries = nullptr) : mode(mode) {
+        phaseTimer construct_timer("construct", "Construct transfer functions");
+        if(mode == ANDERSEN){
+          andersen.reset(new andersenSolver(F));
+          construct_timer.stop();
+          phaseTimer solve_timer("solve", "Solve to a fixed point");
+          everywhere = andersen->solve();
+          return;
+        }
+        solver.reset(new mayPoint(F, budget, summaries));
+        construct_timer.stop();
+        solver->strategy = strategy;
+        blockState<valueType> previous = solver->initial_state(solver->bottom());
+        std::string analysis = budget_cache_tag(summaries ? "maypoint-interprocedural" : "maypoint", budget);
+        if(summaries && !analysis.empty()){
+          analysis = summary_cache_tag(F, *summaries, analysis);
+        }
+        solve_with_cache(analysis.empty() ? nullptr : cache, F, analysis, previous, [&](){
+          solver->run_dataflow(F, previous);
+        });
+        query.reset(new instructionQuery<valueType>(solver->makeInstructionQuery(std::move(previous))));
+      }
+
+      bool flow_sensitive() const{
+        return mode == FLOW_SENSITIVE;
+      }
+
+      // The block fixed point; flow-sensitive mode only
+      blockState<valueType>& fixed_point(){
+        return query->fixed_point;
+      }
+
+      // Maps after each instruction; flow-sensitive mode only
+      instructionQuery<valueType>& instructions(){
+        return *query;
+      }
+
+      // The map that holds at every instruction; Andersen mode only
+      const valueType& flow_insensitive_map() const{
+        return everywhere;
+      }
+
+      // Points-to map after inst. The reference stays valid until the next
+      // instruction query.
+      const valueType& after(Instruction* inst){
+        return mode == ANDERSEN ? everywhere : query->valueAt(inst);
+      }
+
+      // What v may point to after inst; unknownSet() if its set collapsed
+      pointsToSet points_to(Value* v, Instruction* inst){
+        return after(inst).get(v);
+      }
+
+      // Whether a and b may point to a common location after inst
+      bool may_alias(Value* a, Value* b, Instruction* inst){
+        const valueType& map = after(inst);
+        pointsToSet a_points_to = map.get(a);
+        pointsToSet b_points_to = map.get(b);
+        if(!a_points_to || !b_points_to){
+          return false;
+        }
+        if(a_points_to == unknownSet() || b_points_to == unknownSet()){
+          return true;
+        }
+        auto a_it = a_points_to->begin(), b_it = b_points_to->begin();
+        while(a_it != a_points_to->end() && b_it != b_points_to->end()){
+          if(*a_it == *b_it){
+            return true;
+          }
+          if(*a_it < *b_it){
+            ++a_it;
+          }
+          else{
+            ++b_it;
+          }
+        }
+        return false;
+      }
+
+      // The value numbered idx in the points-to sets
+      Value* location(unsigned idx) const{
+        return context().numbering.values[idx];
+      }
+
+      // Whether the precision budget collapsed any points-to set
+      bool collapsed() const{
+        return mode == FLOW_SENSITIVE && solver->context.collapsed_sets;
+      }
+
+      // Brings the result up to date after a transform edited F, so that the
+      // transform can keep MayPointAnalysis preserved. dirty lists the blocks
+      // whose instructions changed, including added blocks. Andersen mode has
+      // no incremental form and solves F again. The update gets the evaluation
+      // and time budgets afresh; sets collapsed by the first solve stay
+      // collapsed only where the update does not recompute them.
+      void update(Function &F, ArrayRef<BasicBlock*> dirty){
+        if(mode == ANDERSEN){
+          everywhere = valueType();
+          *this = MayPointInfo(F, ANDERSEN);
+          return;
+        }
+        blockState<valueType> previous = std::move(query->fixed_point);
+        solver->reanalyze(F, previous, dirty);
+        query.reset(new instructionQuery<valueType>(solver->makeInstructionQuery(std::move(previous))));
+      }
+
+      // Points-to sets read only the instructions and the CFG of F, so the
+      // result stays valid exactly when the analysis itself, or every analysis
+      // of the function, is preserved
+      bool invalidate(Function &F, const PreservedAnalyses &PA, FunctionAnalysisManager::Invalidator &);
+
+    private:
+      maypointMode mode;
+      std::unique_ptr<mayPoint> solver;
+      std::unique_ptr<andersenSolver> andersen;
+      std::unique_ptr<instructionQuery<valueType>> query;
+      valueType everywhere; // Declared after andersen so that it is destroyed first
+
+      const pointsToContext& context() const{
+        return mode == ANDERSEN ? andersen->context : solver->context;
+      }
+  };
+
+  // Computes MayPointInfo once per function; the analysis manager caches it
+  // until a pass does not preserve it
+  class MayPointAnalysis : public AnalysisInfoMixin<MayPointAnalysis>{
+    public:
+      typedef MayPointInfo Result;
+      maypointMode mode;
+      solverStrategy strategy;
+      resultCache* cache;
+      precisionBudget budget;
+
+      MayPointAnalysis(maypointMode mode = FLOW_SENSITIVE, solverStrategy strategy = WORKLIST, resultCache* cache = nullptr, precisionBudget budget = precisionBudget()) : mode(mode), strategy(strategy), cache(cache), budget(budget) {}
+
+      Result run(Function &F, FunctionAnalysisManager &){
+        return MayPointInfo(F, mode, strategy, cache, budget);
+      }
+
+    private:
+      friend AnalysisInfoMixin<MayPointAnalysis>;
+      static AnalysisKey Key;
+  };
+
+  inline bool MayPointInfo::invalidate(Function &F, const PreservedAnalyses &PA, FunctionAnalysisManager::Invalidator &){
+    auto checker = PA.getChecker<MayPointAnalysis>();
+    return !checker.preserved() && !checker.preservedSet<AllAnalysesOn<Function>>();
+  }
+
+  // Result of MayPointSummaryAnalysis: the summary of every defined function
+  // of a module
+  class MayPointSummaries{
+    public:
+      summaryTable summaries;
+
+      // Summaries read only the instructions and call graph of the module
+      bool invalidate(Module &M, const PreservedAnalyses &PA, ModuleAnalysisManager::Invalidator &);
+  };
+
+  // Computes the interprocedural summaries with summarySolver
+  class MayPointSummaryAnalysis : public AnalysisInfoMixin<MayPointSummaryAnalysis>{
+    public:
+      typedef MayPointSummaries Result;
+      solverStrategy strategy;
+      precisionBudget budget;
+      resultCache* cache;
+      unsigned threads;
+
+      MayPointSummaryAnalysis(solverStrategy strategy = WORKLIST, precisionBudget budget = precisionBudget(), resultCache* cache = nullptr, unsigned threads = 0) : strategy(strategy), budget(budget), cache(cache), threads(threads) {}
+
+      Result run(Module &M, ModuleAnalysisManager &){
+        summarySolver solver(M, strategy, budget, cache);
+        solver.run(threads);
+        return Result{std::move(solver.summaries)};
+      }
+
+    private:
+      friend AnalysisInfoMixin<MayPointSummaryAnalysis>;
+      static AnalysisKey Key;
+  };
+
+  inline bool MayPointSummaries::invalidate(Module &M, const PreservedAnalyses &PA, ModuleAnalysisManager::Invalidator &){
+    auto checker = PA.getChecker<MayPointSummaryAnalysis>();
+    return !checker.preserved() && !checker.preservedSet<AllAnalysesOn<Module>>();
+  }
+
+  // print<maypoint>: prints the cached MayPointAnalysis result in the format
+  // chosen by -maypoint-output
+  class MayPointPrinterPass : public PassInfoMixin<MayPointPrinterPass>{
+    public:
+      explicit MayPointPrinterPass(raw_ostream &OS) : OS(OS) {}
+      PreservedAnalyses run(Function &F, FunctionAnalysisManager &FAM);
+
+    private:
+      raw_ostream &OS;
+  };
+
+  // print<maypoint-interprocedural>: prints the points-to maps of every
+  // function with the summaries of MayPointSummaryAnalysis applied at calls,
+  // each followed by the function's own summary
+  class MayPointInterproceduralPrinterPass : public PassInfoMixin<MayPointInterproceduralPrinterPass>{
+    public:
+      explicit MayPointInterproceduralPrinterPass(raw_ostream &OS) : OS(OS) {}
+      PreservedAnalyses run(Module &M, ModuleAnalysisManager &MAM);
+
+    private:
+      raw_ostream &OS;
+  };
+}
+
+// Registers MayPointAnalysis as "maypoint", MayPointSummaryAnalysis as
+// "maypoint-summaries" and the printers as "print<maypoint>" and
+// "print<maypoint-interprocedural>" with a PassBuilder
+PassPluginLibraryInfo getMaypointPluginInfo();
+
+// The cache set up by -maypoint-cache-dir, or nullptr
+resultCache* getMaypointResultCache();
+
+#endif
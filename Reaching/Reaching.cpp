@@ -2,100 +2,150 @@
 #include "llvm/ADT/Statistic.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
 #include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/IR/CFG.h" // For iterating over predecessors of a basic block
 #include "llvm/Analysis/Dataflow.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/PassPlugin.h"
+#include "Reaching.h"
+#include "ReachingAnalysis.h"
 #include <map>
 #include <set>
 
 using namespace llvm;
+using namespace reaching;
 
 #define DEBUG_TYPE "reaching"
 
+static cl::opt<solverStrategy> ReachingSolver("reaching-solver",
+    cl::desc("Fixed-point strategy for the Reaching pass"),
+    cl::init(WORKLIST), solverStrategyValues());
+static cl::opt<reachingEngine> ReachingEngine("reaching-engine",
+    cl::desc("How the Reaching pass computes its fixed point"),
+    cl::init(CONDENSED), cl::values(
+      clEnumValN(CONDENSED, "condensed", "Single pass in topological order of the CFG's strongly connected components"),
+      clEnumValN(ITERATIVE, "iterative", "Iterate the transfer functions to a fixed point")));
+static cl::opt<unsigned> ReachingThreads("reaching-threads",
+    cl::desc("Threads used by -reaching-parallel and -reaching-solver=components (0 = all hardware threads)"),
+    cl::init(0));
+static cl::opt<outputMode> ReachingOutput("reaching-output",
+    cl::desc("What the Reaching pass prints"),
+    cl::init(FULL_OUTPUT), outputModeValues());
+static cl::opt<std::string> ReachingCacheDir("reaching-cache-dir",
+    cl::desc("Directory of an on-disk cache of Reaching fixed points, keyed by function structure"),
+    cl::value_desc("directory"));
+static cl::opt<unsigned> ReachingCacheSize("reaching-cache-size",
+    cl::desc("Size cap of -reaching-cache-dir in MiB; the least recently used entries are evicted"),
+    cl::init(256));
+
 
 namespace {
-  class valueType : public std::set<Instruction*>{
-    public:
-      valueType operator ^ (valueType a){
-        valueType result(a);
-        result.insert(this->begin(),this->end());
-        return result;
-      }
-  };
+  struct Reaching : public FunctionPass {
+    static char ID; // Pass identification, replacement for typeid
+    Reaching() : FunctionPass(ID) {}
+    // Runs the analysis on F and prints the result to OS
+    static void analyzeFunction(Function &F, raw_ostream &OS){
+      ReachingInfo info(F, ReachingEngine, ReachingSolver, ReachingThreads, getReachingResultCache());
+      printResults(info, F, OS);
+    }
 
-  class ReachingDFA : public dataFlow<valueType>{
-    private:
-      void construct_transfer_function_objects(Function& F){
-        for(auto&& bb : F.getBasicBlockList()){
-          transferFunction<valueType> tf;
-          BasicBlock* bb_pointer = &bb;
-          tf.basic_block = bb_pointer;
-          tf.is_forward = is_forward;
-          tf.blockToTransferFunctionsMap = &allTransferFunctions;
-          tf.blockTransferFunction = [bb_pointer](valueType in){
-            valueType out(in);
-            for(auto inst = bb_pointer->begin(); inst != bb_pointer->end(); ++inst){
-              if(!inst->getType()->isVoidTy())
-                out.insert(&*inst);
-            }
-            return out;
-          };
-          allTransferFunctions[bb_pointer] = tf;
-        }
+    // Prints info, the result of the analysis on F, as chosen by
+    // -reaching-output
+    static void printResults(ReachingInfo& info, Function& F, raw_ostream &OS){
+      resultEmitter emitter(F, OS, ReachingOutput);
+      if(emitter.mode == FULL_OUTPUT){
+        F.print(emitter.out());
       }
-    public:
-      ReachingDFA(Function& F){
-        is_forward = true;
-        construct_transfer_function_objects(F);
+      phaseTimer print_timer("print", "Print results");
+      if(emitter.mode == SUMMARY_OUTPUT){
+        emit_block_summaries(emitter, F, info.fixed_point());
+        return;
       }
-      std::map<Instruction*, valueType> propagate_to_instructions(Function& F, std::map<std::pair<BasicBlock*,bool>, valueType> bbFixedPoint){
-        std::map<Instruction*, valueType> instructionFixedPoint;
-        for(auto&& bb: F.getBasicBlockList()){
-          valueType current = bbFixedPoint[std::make_pair(&bb,true)];
-          for(auto inst = bb.begin(); inst != bb.end(); ++inst){
-            instructionFixedPoint[&*inst] = current;
-            current.insert(&*inst);
-          }
-        }
-        return instructionFixedPoint;
+      instructionQuery<valueType>& query = info.instructions();
+      if(emitter.mode == JSON_OUTPUT){
+        emit_json(emitter, F, query);
+        return;
       }
-  };
-
-
-  struct Reaching : public FunctionPass {
-    static char ID; // Pass identification, replacement for typeid
-    Reaching() : FunctionPass(ID) {}
-    bool runOnFunction(Function &F) override {
-      ReachingDFA rd(F);
-      std::map<std::pair<BasicBlock*, bool>, valueType> previous;
-      for(auto& bb: F.getBasicBlockList()){
-        valueType set_in;
-        valueType set_out;
-        previous[std::make_pair(&bb,true)] = set_in;
-        previous[std::make_pair(&bb,false)] = set_out;
+      if(emitter.mode == NO_OUTPUT){
+        return;
       }
-      F.print(outs());
-      rd.run_dataflow(F, previous);
-      std::map<Instruction*, valueType> instructionFixedPoint = rd.propagate_to_instructions(F, previous);
-      outs() << "Reacing Defs. Analysis\n";
+      raw_ostream& out = emitter.out();
+      out << "Reacing Defs. Analysis\n";
       for(auto&& bb : F.getBasicBlockList()){
-        bb.printAsOperand(outs());
-        outs() << ":\n";
+        emitter.operand(&bb);
+        out << ":\n";
         for(auto inst = bb.begin(); inst != bb.end(); ++inst){
-          valueType reachingDefs = instructionFixedPoint[&*inst];
-          outs() << "{";
-          std::for_each(reachingDefs.begin(), reachingDefs.end(), [](Value* v){v->printAsOperand(outs()); outs() << ", ";});
-          outs() << "}\n";
-          inst->print(outs());
-          outs() << "\n";
+          print_lattice(emitter, query.valueAt(&*inst));
+          emitter.instruction(*inst);
+          out << "\n";
         }
-        outs() << "\n\n";
+        out << "\n\n";
+        emitter.end_record();
       }
+    }
+
+    bool runOnFunction(Function &F) override {
+      analyzeFunction(F, outs());
+      return false;
+    }
+  };
+
+  // Module-level mode. Functions are independent for this intraprocedural
+  // analysis, so they are solved concurrently and their buffered output is
+  // emitted in module order.
+  struct ReachingParallel : public ModulePass {
+    static char ID;
+    ReachingParallel() : ModulePass(ID) {}
+    bool runOnModule(Module &M) override {
+      run_on_functions_in_parallel(M, ReachingThreads, Reaching::analyzeFunction, outs());
       return false;
     }
   };
 }
 
 char Reaching::ID = 0;
-static RegisterPass<Reaching> X("reaching", "Reaching Definitions pass");
\ No newline at end of file
+static RegisterPass<Reaching> X("reaching", "Reaching Definitions pass");
+char ReachingParallel::ID = 0;
+static RegisterPass<ReachingParallel> Y("reaching-parallel", "Reaching Definitions pass, all functions in parallel");
+
+resultCache* getReachingResultCache(){
+  static std::unique_ptr<resultCache> cache = ReachingCacheDir.empty() ? nullptr : std::unique_ptr<resultCache>(new resultCache(ReachingCacheDir, (uint64_t)ReachingCacheSize << 20));
+  return cache.get();
+}
+
+AnalysisKey ReachingAnalysis::Key;
+
+PreservedAnalyses ReachingPrinterPass::run(Function &F, FunctionAnalysisManager &FAM){
+  Reaching::printResults(FAM.getResult<ReachingAnalysis>(F), F, OS);
+  return PreservedAnalyses::all();
+}
+
+// New pass manager: the options of the legacy pass configure the analysis,
+// and require<reaching> or invalidate<reaching> name it in a pipeline
+PassPluginLibraryInfo getReachingPluginInfo(){
+  return {LLVM_PLUGIN_API_VERSION, "Reaching", LLVM_VERSION_STRING, [](PassBuilder &PB){
+    PB.registerAnalysisRegistrationCallback([](FunctionAnalysisManager &FAM){
+      FAM.registerPass([](){
+        return ReachingAnalysis(ReachingEngine, ReachingSolver, ReachingThreads, getReachingResultCache());
+      });
+    });
+    PB.registerPipelineParsingCallback([](StringRef Name, FunctionPassManager &FPM, ArrayRef<PassBuilder::PipelineElement>){
+      if(Name == "print<reaching>"){
+        FPM.addPass(ReachingPrinterPass(outs()));
+        return true;
+      }
+      return parseAnalysisUtilityPasses<ReachingAnalysis>("reaching", Name, FPM);
+    });
+  }};
+}
+
+// Tools linking the pass in statically register it through
+// getReachingPluginInfo instead
+#ifndef LLVM_REACHING_LINK_INTO_TOOLS
+extern "C" LLVM_ATTRIBUTE_WEAK PassPluginLibraryInfo llvmGetPassPluginInfo(){
+  return getReachingPluginInfo();
+}
+#endif
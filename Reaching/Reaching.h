@@ -0,0 +1,127 @@
+// ===- Reaching.h Reaching definitions solver, shared by the pass and the tools ---===//
+#ifndef DATAFLOW_REACHING_H
+#define DATAFLOW_REACHING_H
+
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Analysis/Dataflow.h"
+#include <map>
+#include <set>
+
+namespace reaching {
+  typedef bitVectorSet<Instruction*> valueType;
+
+  class ReachingDFA : public genKillDataFlow<valueType, Instruction*, forwardDirection>{
+    private:
+      // Every instruction producing a value generates itself; nothing is killed
+      // in SSA form.
+      void summarize_block(unsigned bb_idx){
+        BasicBlock* bb = blocks.blocks[bb_idx];
+        genKillSummary<valueType, Instruction*>& summary = transfer.blockSummaries[bb_idx];
+        for(auto inst = bb->begin(); inst != bb->end(); ++inst){
+          if(!inst->getType()->isVoidTy())
+            summary.add(&*inst);
+        }
+      }
+
+      void construct_transfer_function_objects(Function& F){
+        init_summaries();
+        for(unsigned bb_idx = 0; bb_idx < blocks.size(); bb_idx++){
+          summarize_block(bb_idx);
+        }
+      }
+    public:
+      valueNumbering numbering;
+      ReachingDFA(Function& F){
+        number_blocks(F);
+        numbering.init(F);
+        top = valueType(&numbering, &arena);
+        construct_transfer_function_objects(F);
+      }
+      // The fixed point of run_dataflow, computed without iterating. Nothing is
+      // killed, so a definition reaches the end of a block exactly when a path
+      // leads there from the definition. Visiting the strongly connected
+      // components of the CFG in topological order, each component needs the
+      // OUT sets of its predecessors outside it once; inside a cyclic component
+      // every block sees the definitions of the whole component.
+      void run_condensed(blockState<valueType>& previous){
+        phaseTimer timer("solve", "Solve to a fixed point");
+        counters = solverCounters();
+        counters.iterations = 1;
+        cfgComponents components;
+        components.init(blocks);
+        for(unsigned component = 0; component < components.size(); component++){
+          ArrayRef<unsigned> members = components.blocks_of(component);
+          valueType& in = next_in;
+          in = top;
+          for(unsigned idx : members){
+            for(unsigned pred : blocks.pred_indices(idx)){
+              if(components.component[pred] != component){
+                in.unite(previous.out(pred));
+                counters.meets++;
+              }
+            }
+          }
+          counters.block_evaluations += members.size();
+          if(!components.cyclic[component]){
+            unsigned idx = members.front();
+            transfer.blockSummaries[idx].apply(in, previous.out(idx));
+            previous.in(idx) = in;
+            counters.transfer_calls++;
+            counters.changes++;
+            continue;
+          }
+          for(unsigned idx : members){
+            in.unite(transfer.blockSummaries[idx].gen);
+            counters.transfer_calls++;
+          }
+          for(unsigned idx : members){
+            previous.in(idx) = in;
+            previous.out(idx) = in;
+            counters.changes++;
+          }
+        }
+        if(AreStatisticsEnabled()){
+          record_statistics(previous);
+        }
+      }
+
+      // Whether def reaches inst (is in the set reported before inst), in
+      // constant time from bbFixedPoint, the block fixed point. Nothing is
+      // killed, so that is when def comes before inst in its block or
+      // reaches the block's IN. Instructions without a value, like stores,
+      // define nothing and reach nothing.
+      bool reaches(Instruction* def, Instruction* inst, blockState<valueType>& bbFixedPoint){
+        if(def->getType()->isVoidTy()){
+          return false;
+        }
+        if(def->getParent() == inst->getParent() && def->comesBefore(inst)){
+          return true;
+        }
+        return bbFixedPoint.in(inst->getParent()).count(def);
+      }
+
+      // Brings bbFixedPoint, the result before an edit of F, up to date with
+      // the iterative solver. dirty lists the blocks whose instructions
+      // changed, including added blocks; only their summaries are rebuilt.
+      void reanalyze(Function &F, blockState<valueType>& bbFixedPoint, ArrayRef<BasicBlock*> dirty){
+        std::vector<unsigned> retired = numbering.update(F);
+        top = valueType(&numbering, &arena);
+        genKillDataFlow::reanalyze(F, bbFixedPoint, dirty, retired, [this](unsigned bb_idx){
+          summarize_block(bb_idx);
+        });
+      }
+
+      // Definitions reaching each instruction (before it executes), computed on
+      // demand from the block fixed point. As in the block summaries, only
+      // instructions producing a value are definitions.
+      instructionQuery<valueType> make_instruction_query(blockState<valueType> bbFixedPoint){
+        return instructionQuery<valueType>(std::move(bbFixedPoint), true, false, [](Instruction* inst, valueType& current){
+          if(!inst->getType()->isVoidTy())
+            current.insert(inst);
+        });
+      }
+  };
+}
+
+#endif
@@ -0,0 +1,136 @@
+// ===- ReachingAnalysis.h Reaching definitions for the new pass manager ---===//
+#ifndef DATAFLOW_REACHING_ANALYSIS_H
+#define DATAFLOW_REACHING_ANALYSIS_H
+
+#include "llvm/IR/PassManager.h"
+#include "llvm/Passes/PassPlugin.h"
+#include "Reaching.h"
+#include <memory>
+
+namespace reaching {
+  enum reachingEngine{
+    CONDENSED, // One pass over the strongly connected components of the CFG
+    ITERATIVE // The generic fixed-point solver
+  };
+
+  // Result of ReachingAnalysis: the block fixed point of one function, and
+  // the solver whose numbering and arena its sets live in. The definitions
+  // reaching an instruction are replayed from the block's IN on demand.
+  class ReachingInfo{
+    public:
+      // With a cache, a fixed point stored for a function of the same
+      // structure is used instead of solving
+      ReachingInfo(Function &F, reachingEngine engine = CONDENSED, solverStrategy strategy = WORKLIST, unsigned threads = 0, resultCache* cache = nullptr){
+        phaseTimer construct_timer("construct", "Construct transfer functions");
+        solver.reset(new ReachingDFA(F));
+        construct_timer.stop();
+        solver->strategy = strategy;
+        solver->threads = threads;
+        blockState<valueType> previous = solver->initial_state(solver->top);
+        solve_with_cache(cache, F, "reaching", previous, [&](){
+          if(engine == CONDENSED){
+            solver->run_condensed(previous);
+          }
+          else{
+            solver->run_dataflow(F, previous);
+          }
+        });
+        query.reset(new instructionQuery<valueType>(solver->make_instruction_query(std::move(previous))));
+      }
+
+      blockState<valueType>& fixed_point(){
+        return query->fixed_point;
+      }
+
+      const valueType& reaching_in(BasicBlock* bb){
+        return query->fixed_point.in(bb);
+      }
+
+      const valueType& reaching_out(BasicBlock* bb){
+        return query->fixed_point.out(bb);
+      }
+
+      // Definitions reaching inst, before it executes. The reference stays
+      // valid until the next instruction query.
+      const valueType& reaching_before(Instruction* inst){
+        return query->valueAt(inst);
+      }
+
+      // Whether def reaches inst, without replaying any block
+      bool reaches(Instruction* def, Instruction* inst){
+        return solver->reaches(def, inst, query->fixed_point);
+      }
+
+      instructionQuery<valueType>& instructions(){
+        return *query;
+      }
+
+      const solverCounters& counters() const{
+        return solver->counters;
+      }
+
+      // Brings the result up to date after a transform edited F, so that the
+      // transform can keep ReachingAnalysis preserved. dirty lists the blocks
+      // whose instructions changed, including added blocks.
+      void update(Function &F, ArrayRef<BasicBlock*> dirty){
+        blockState<valueType> previous = std::move(query->fixed_point);
+        solver->reanalyze(F, previous, dirty);
+        query.reset(new instructionQuery<valueType>(solver->make_instruction_query(std::move(previous))));
+      }
+
+      // Reaching definitions read only the instructions and the CFG of F, so
+      // the result stays valid exactly when the analysis itself, or every
+      // analysis of the function, is preserved
+      bool invalidate(Function &F, const PreservedAnalyses &PA, FunctionAnalysisManager::Invalidator &);
+
+    private:
+      std::unique_ptr<ReachingDFA> solver;
+      std::unique_ptr<instructionQuery<valueType>> query;
+  };
+
+  // Computes ReachingInfo once per function; the analysis manager caches it
+  // until a pass does not preserve it
+  class ReachingAnalysis : public AnalysisInfoMixin<ReachingAnalysis>{
+    public:
+      typedef ReachingInfo Result;
+      reachingEngine engine;
+      solverStrategy strategy;
+      unsigned threads;
+      resultCache* cache;
+
+      ReachingAnalysis(reachingEngine engine = CONDENSED, solverStrategy strategy = WORKLIST, unsigned threads = 0, resultCache* cache = nullptr) : engine(engine), strategy(strategy), threads(threads), cache(cache) {}
+
+      Result run(Function &F, FunctionAnalysisManager &){
+        return ReachingInfo(F, engine, strategy, threads, cache);
+      }
+
+    private:
+      friend AnalysisInfoMixin<ReachingAnalysis>;
+      static AnalysisKey Key;
+  };
+
+  inline bool ReachingInfo::invalidate(Function &F, const PreservedAnalyses &PA, FunctionAnalysisManager::Invalidator &){
+    auto checker = PA.getChecker<ReachingAnalysis>();
+    return !checker.preserved() && !checker.preservedSet<AllAnalysesOn<Function>>();
+  }
+
+  // print<reaching>: prints the cached ReachingAnalysis result in the format
+  // chosen by -reaching-output
+  class ReachingPrinterPass : public PassInfoMixin<ReachingPrinterPass>{
+    public:
+      explicit ReachingPrinterPass(raw_ostream &OS) : OS(OS) {}
+      PreservedAnalyses run(Function &F, FunctionAnalysisManager &FAM);
+
+    private:
+      raw_ostream &OS;
+  };
+}
+
+// Registers ReachingAnalysis as "reaching" and ReachingPrinterPass as
+// "print<reaching>" with a PassBuilder
+PassPluginLibraryInfo getReachingPluginInfo();
+
+// The cache set up by -reaching-cache-dir, or nullptr
+resultCache* getReachingResultCache();
+
+#endif